@@ -0,0 +1,95 @@
+#ifndef ARCHIVE_IO_SYSTEM_H
+#define ARCHIVE_IO_SYSTEM_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <learnopengl/asset_archive.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// read-only Assimp stream over the bytes of an asset
+class ArchiveIOStream : public Assimp::IOStream
+{
+public:
+    explicit ArchiveIOStream(AssetBytes bytes) : bytes(std::move(bytes)), position(0) {}
+
+    size_t Read(void *buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+        size_t available = (bytes.size - position) / size;
+        if (count > available)
+            count = available;
+        memcpy(buffer, bytes.data + position, size * count);
+        position += size * count;
+        return count;
+    }
+
+    size_t Write(const void *, size_t, size_t) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t target = origin == aiOrigin_SET ? offset : origin == aiOrigin_CUR ? position + offset : bytes.size + offset;
+        if (target > bytes.size)
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return bytes.size; }
+    void Flush() override {}
+
+private:
+    AssetBytes bytes;
+    size_t position;
+};
+
+// lets Assimp read models and the files they reference (materials, ...) through the AssetArchive. Hand a new one
+// to each Importer, which deletes it.
+class ArchiveIOSystem : public Assimp::IOSystem
+{
+public:
+    // every file Open found, in the order first opened
+    const std::vector<std::string> &Opened() const { return opened; }
+
+    bool Exists(const char *path) const override
+    {
+        return AssetArchive::Instance().Exists(path);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream *Open(const char *path, const char *mode = "rb") override
+    {
+        if (strchr(mode, 'w') || strchr(mode, 'a'))
+            return nullptr;
+        AssetBytes bytes = AssetArchive::Instance().Read(path);
+        if (!bytes.found)
+            return nullptr;
+        if (std::find(opened.begin(), opened.end(), path) == opened.end())
+            opened.push_back(path);
+        return new ArchiveIOStream(std::move(bytes));
+    }
+
+    void Close(Assimp::IOStream *stream) override
+    {
+        delete stream;
+    }
+
+private:
+    std::vector<std::string> opened;
+};
+
+#endif
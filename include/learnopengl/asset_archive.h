@@ -0,0 +1,255 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <learnopengl/lz4.h>
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// All assets of the game packed into one file, so startup maps a single file and reads it front to back instead of
+// opening and seeking through hundreds of loose ones. Written by tools/asset_packer.cpp.
+//
+// file layout:
+//   ArchiveHeader
+//   payloads, each starting at a multiple of ASSET_ARCHIVE_ALIGNMENT, in the order they were packed
+//   ArchiveEntry[entryCount] at indexOffset, then the entry paths back to back at namesOffset
+//
+// Entries are stored as is or LZ4 compressed. Stored entries are served straight out of the mapping, compressed
+// ones are decompressed into a buffer of their own.
+const char *const ASSET_ARCHIVE_MAGIC = "RGPK";
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const uint64_t ASSET_ARCHIVE_ALIGNMENT = 4096;
+
+enum ArchiveCompression : uint32_t {
+    ARCHIVE_STORED = 0,
+    ARCHIVE_LZ4 = 1,
+};
+
+struct ArchiveHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t padding;
+    uint64_t indexOffset;
+    uint64_t namesOffset;
+};
+
+struct ArchiveEntry {
+    uint64_t offset;
+    uint64_t storedSize;
+    uint64_t size;          // after decompression
+    int64_t sourceMtime;    // of the packed file, stands in for it where caches check their source is unchanged
+    uint32_t nameOffset;    // relative to namesOffset
+    uint32_t nameLength;
+    uint32_t compression;
+    uint32_t padding;
+};
+
+// the contents of one asset. data points into the archive mapping or into owned, and stays valid as long as
+// the archive stays open or this object lives, respectively.
+struct AssetBytes {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    shared_ptr<vector<unsigned char>> owned;
+    bool found = false;
+};
+
+// Serves asset files by path from the archive if one is open and has them, else from the loose files on disk, so
+// development keeps working without repacking. Open before anything loads; lookups may then run on any thread.
+class AssetArchive
+{
+public:
+    static AssetArchive &Instance()
+    {
+        static AssetArchive archive;
+        return archive;
+    }
+
+    // maps the archive. Paths passed to the other functions are looked up relative to root, which is stripped
+    // from their front. Returns false and stays in loose file mode if the archive is missing or broken.
+    bool Open(const string &path, const string &root = "")
+    {
+        Close();
+        this->root = root;
+        if (!file.Open(path))
+            return false;
+        const ArchiveHeader *header = (const ArchiveHeader *)file.Data();
+        if (file.Size() < sizeof(ArchiveHeader) || memcmp(header->magic, ASSET_ARCHIVE_MAGIC, 4) != 0
+            || header->version != ASSET_ARCHIVE_VERSION || header->indexOffset > file.Size()
+            || (uint64_t)header->entryCount * sizeof(ArchiveEntry) > file.Size() - header->indexOffset
+            || header->namesOffset > file.Size())
+        {
+            cout << "ERROR::ASSET_ARCHIVE:: " << path << " is not a valid archive" << endl;
+            Close();
+            return false;
+        }
+        entries = (const ArchiveEntry *)(file.Data() + header->indexOffset);
+        names = (const char *)(file.Data() + header->namesOffset);
+        size_t namesSize = file.Size() - header->namesOffset;
+        for (uint32_t i = 0; i < header->entryCount; i++)
+        {
+            const ArchiveEntry &entry = entries[i];
+            if (entry.offset > file.Size() || entry.storedSize > file.Size() - entry.offset
+                || entry.nameOffset > namesSize || entry.nameLength > namesSize - entry.nameOffset)
+            {
+                cout << "ERROR::ASSET_ARCHIVE:: " << path << " has a broken entry" << endl;
+                Close();
+                return false;
+            }
+            index[string(names + entry.nameOffset, entry.nameLength)] = i;
+        }
+        archivePath = path;
+        cout << "ASSETS::ARCHIVE " << path << " " << index.size() << " entries, " << file.Size() / (1024.0 * 1024.0) << " MB" << endl;
+        return true;
+    }
+
+    void Close()
+    {
+        index.clear();
+        entries = nullptr;
+        names = nullptr;
+        file.Close();
+    }
+
+    bool IsOpen() const { return file.IsOpen(); }
+
+    // reads an asset, from the archive if it has it and from disk otherwise. found is false if neither has it.
+    AssetBytes Read(const string &path) const
+    {
+        AssetBytes bytes;
+        const ArchiveEntry *entry = find(path);
+        if (!entry)
+        {
+            readLoose(path, bytes);
+            return bytes;
+        }
+        const unsigned char *stored = file.Data() + entry->offset;
+        if (entry->compression == ARCHIVE_STORED)
+        {
+            bytes.data = stored;
+            bytes.size = (size_t)entry->size;
+        }
+        else
+        {
+            bytes.owned = make_shared<vector<unsigned char>>((size_t)entry->size);
+            if (entry->compression != ARCHIVE_LZ4
+                || !Lz4Decompress(stored, (size_t)entry->storedSize, bytes.owned->data(), bytes.owned->size()))
+            {
+                cout << "ERROR::ASSET_ARCHIVE:: could not decompress " << path << endl;
+                return AssetBytes();
+            }
+            bytes.data = bytes.owned->data();
+            bytes.size = bytes.owned->size();
+            decompressedBytes += bytes.size;
+        }
+        bytes.found = true;
+        archiveReads++;
+        archiveBytes += bytes.size;
+        return bytes;
+    }
+
+    bool Exists(const string &path) const
+    {
+        struct stat st;
+        return find(path) || stat(path.c_str(), &st) == 0;
+    }
+
+    // modification time and size of an asset, as it was when packed for archived ones
+    bool Stat(const string &path, int64_t &mtime, uint64_t &size) const
+    {
+        if (const ArchiveEntry *entry = find(path))
+        {
+            mtime = entry->sourceMtime;
+            size = entry->size;
+            return true;
+        }
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        mtime = (int64_t)st.st_mtime;
+        size = (uint64_t)st.st_size;
+        return true;
+    }
+
+    void PrintStats() const
+    {
+        double megabyte = 1024.0 * 1024.0;
+        cout << "ASSETS:: " << archiveReads << " reads from " << (IsOpen() ? archivePath : "no archive") << " ("
+             << archiveBytes / megabyte << " MB, " << decompressedBytes / megabyte << " MB of it decompressed), "
+             << looseReads << " loose file reads (" << looseBytes / megabyte << " MB)" << endl;
+    }
+
+    // path as stored in the archive: relative to the root, without "." segments or doubled separators
+    static string Normalize(const string &path, const string &root = "")
+    {
+        string relative = !root.empty() && path.compare(0, root.size(), root) == 0 ? path.substr(root.size()) : path;
+        vector<string> segments;
+        size_t start = 0;
+        while (start <= relative.size())
+        {
+            size_t end = relative.find_first_of("/\\", start);
+            if (end == string::npos)
+                end = relative.size();
+            string segment = relative.substr(start, end - start);
+            if (segment == ".." && !segments.empty() && segments.back() != "..")
+                segments.pop_back();
+            else if (!segment.empty() && segment != ".")
+                segments.push_back(segment);
+            start = end + 1;
+        }
+        string normalized;
+        for (const string &segment : segments)
+            normalized += (normalized.empty() ? "" : "/") + segment;
+        return normalized;
+    }
+
+private:
+    MappedFile file;
+    string archivePath;
+    string root;
+    const ArchiveEntry *entries = nullptr;
+    const char *names = nullptr;
+    unordered_map<string, uint32_t> index;
+    mutable atomic<size_t> archiveReads{0};
+    mutable atomic<size_t> archiveBytes{0};
+    mutable atomic<size_t> decompressedBytes{0};
+    mutable atomic<size_t> looseReads{0};
+    mutable atomic<size_t> looseBytes{0};
+
+    AssetArchive() = default;
+
+    const ArchiveEntry *find(const string &path) const
+    {
+        if (index.empty())
+            return nullptr;
+        auto found = index.find(Normalize(path, root));
+        return found == index.end() ? nullptr : &entries[found->second];
+    }
+
+    void readLoose(const string &path, AssetBytes &bytes) const
+    {
+        ifstream in(path, ios::binary | ios::ate);
+        if (!in)
+            return;
+        bytes.owned = make_shared<vector<unsigned char>>((size_t)in.tellg());
+        in.seekg(0);
+        in.read((char *)bytes.owned->data(), bytes.owned->size());
+        bytes.data = bytes.owned->data();
+        bytes.size = bytes.owned->size();
+        bytes.found = true;
+        looseReads++;
+        looseBytes += bytes.size;
+    }
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef BILLBOARD_BATCH_H
+#define BILLBOARD_BATCH_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_state.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// where and how one billboard of a BillboardBatch stands
+struct BillboardInstance {
+    glm::vec3 position;
+    float scale;        // uniform
+    float rotation;     // about the y axis, in radians
+};
+
+// Draws any number of copies of one quad (a bush, a tuft of grass) with a single glDrawArraysInstanced. The
+// instances live in a vertex buffer with an attribute divisor of 1, read by blending_instanced.vs:
+//   location 2: vec4 position and scale, location 3: float rotation
+// Changing instances only marks them dirty, Upload sends the range that changed once per frame.
+class BillboardBatch
+{
+public:
+    unsigned int VAO = 0;
+
+    // sets up the VAO, sharing quadVBO (vec3 position, vec2 texture coordinates, interleaved) with other users of the
+    // quad. Must run on the GL thread.
+    void Create(unsigned int quadVBO, GLsizei quadVertices)
+    {
+        this->quadVertices = quadVertices;
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &instanceVBO);
+        GLState::Instance().BindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(BillboardInstance), (void*)offsetof(BillboardInstance, position));
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(BillboardInstance), (void*)offsetof(BillboardInstance, rotation));
+        glVertexAttribDivisor(3, 1);
+        GLState::Instance().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // returns the index of the new instance
+    size_t Add(const BillboardInstance &instance)
+    {
+        instances.push_back(instance);
+        markDirty(instances.size() - 1);
+        return instances.size() - 1;
+    }
+
+    void Set(size_t index, const BillboardInstance &instance)
+    {
+        instances[index] = instance;
+        markDirty(index);
+    }
+
+    const BillboardInstance &Get(size_t index) const { return instances[index]; }
+    size_t Size() const { return instances.size(); }
+
+    // sends the instances changed since the last Upload to the GPU, growing the buffer if it is too small
+    void Upload()
+    {
+        if (dirtyBegin >= dirtyEnd)
+            return;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (instances.size() > capacity)
+        {
+            // doubling keeps adding one instance after another from reallocating every time
+            capacity = std::max(instances.size(), capacity * 2);
+            glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(BillboardInstance), nullptr, GL_DYNAMIC_DRAW);
+            dirtyBegin = 0;
+            dirtyEnd = instances.size();
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin * sizeof(BillboardInstance), (dirtyEnd - dirtyBegin) * sizeof(BillboardInstance),
+                        &instances[dirtyBegin]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        dirtyBegin = dirtyEnd = 0;
+
+        glm::vec3 sum(0.0f);
+        glm::vec3 minimum = instances[0].position, maximum = instances[0].position;
+        for (const BillboardInstance &instance : instances)
+        {
+            sum += instance.position;
+            // the quad reaches one scale up, and one scale sideways however it is rotated
+            minimum = glm::min(minimum, instance.position - glm::vec3(instance.scale, 0.0f, instance.scale));
+            maximum = glm::max(maximum, instance.position + glm::vec3(instance.scale));
+        }
+        center = sum / (float)instances.size();
+        bounds = Bounds::OfBox(minimum, maximum);
+    }
+
+    // draws all instances, with the textures bound and the instanced shader in use
+    void Draw()
+    {
+        if (instances.empty())
+            return;
+        GLState::Instance().BindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, quadVertices, (GLsizei)instances.size());
+    }
+
+    // the instance closest to point, for how large the texture gets on screen. Instances must not be empty.
+    const BillboardInstance &Nearest(const glm::vec3 &point) const
+    {
+        size_t nearest = 0;
+        float nearestDistance = glm::dot(instances[0].position - point, instances[0].position - point);
+        for (size_t i = 1; i < instances.size(); i++)
+        {
+            glm::vec3 offset = instances[i].position - point;
+            float distance = glm::dot(offset, offset);
+            if (distance < nearestDistance)
+            {
+                nearest = i;
+                nearestDistance = distance;
+            }
+        }
+        return instances[nearest];
+    }
+
+    // center of the instance positions as of the last Upload, for sorting the batch against other draws
+    glm::vec3 Center() const { return center; }
+    // box and sphere around all instances as of the last Upload, for culling the batch as a whole
+    const Bounds &WorldBounds() const { return bounds; }
+
+    void Delete()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &instanceVBO);
+        VAO = instanceVBO = 0;
+    }
+
+private:
+    vector<BillboardInstance> instances;
+    unsigned int instanceVBO = 0;
+    GLsizei quadVertices = 0;
+    size_t capacity = 0;        // instances the buffer has room for
+    size_t dirtyBegin = 0;      // range of instances changed since the last Upload
+    size_t dirtyEnd = 0;
+    glm::vec3 center = glm::vec3(0.0f);
+    Bounds bounds = Bounds{glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f};
+
+    void markDirty(size_t index)
+    {
+        if (dirtyBegin >= dirtyEnd)
+        {
+            dirtyBegin = index;
+            dirtyEnd = index + 1;
+            return;
+        }
+        dirtyBegin = std::min(dirtyBegin, index);
+        dirtyEnd = std::max(dirtyEnd, index + 1);
+    }
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// x86-64 always has SSE2, elsewhere the plane tests fall back to plain loops
+#if defined(__SSE2__) || defined(_M_X64)
+#define FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+// box and sphere around the same thing, a Frustum tests the cheap sphere first and the tighter box after it
+struct Bounds {
+    glm::vec3 minimum;
+    glm::vec3 maximum;
+    glm::vec3 center;
+    float radius;
+
+    // the box and the sphere through its corners
+    static Bounds OfBox(const glm::vec3 &minimum, const glm::vec3 &maximum)
+    {
+        return Bounds{minimum, maximum, (minimum + maximum) * 0.5f, glm::length(maximum - minimum) * 0.5f};
+    }
+
+    // bounds after transform: the box around the transformed box (Arvo), the sphere grown by the largest axis scale
+    Bounds Transformed(const glm::mat4 &transform) const
+    {
+        Bounds result;
+        result.minimum = result.maximum = glm::vec3(transform[3]);
+        for (int column = 0; column < 3; column++)
+            for (int row = 0; row < 3; row++)
+            {
+                float a = transform[column][row] * minimum[column];
+                float b = transform[column][row] * maximum[column];
+                result.minimum[row] += glm::min(a, b);
+                result.maximum[row] += glm::max(a, b);
+            }
+        float scale = glm::max(glm::length(glm::vec3(transform[0])),
+                               glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        result.center = glm::vec3(transform * glm::vec4(center, 1.0f));
+        result.radius = radius * scale;
+        return result;
+    }
+};
+
+// how many of something the frustum tests of a frame kept and dropped
+struct VisibilityCounts {
+    size_t visible = 0;
+    size_t culled = 0;
+
+    void Count(bool isVisible)
+    {
+        if (isVisible)
+            visible++;
+        else
+            culled++;
+    }
+
+    VisibilityCounts &operator+=(const VisibilityCounts &other)
+    {
+        visible += other.visible;
+        culled += other.culled;
+        return *this;
+    }
+};
+
+// the six clip planes of a projection, pointing inwards. Built from projection * view they are in world space,
+// from projection * view * model in that model's space.
+struct Frustum {
+    glm::vec4 planes[6];    // left, right, bottom, top, near, far; xyz is a unit normal, w the distance
+    // the planes again, one array per component so four planes are tested at once. The two after the six are
+    // padding that every point is in front of.
+    alignas(16) float planeX[8];
+    alignas(16) float planeY[8];
+    alignas(16) float planeZ[8];
+    alignas(16) float planeW[8];
+
+    // Gribb and Hartmann: every plane is the last row of the matrix plus or minus one of the others
+    static Frustum FromMatrix(const glm::mat4 &clip)
+    {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        Frustum frustum;
+        for (int i = 0; i < 3; i++)
+        {
+            frustum.planes[i * 2] = rows[3] + rows[i];
+            frustum.planes[i * 2 + 1] = rows[3] - rows[i];
+        }
+        for (glm::vec4 &plane : frustum.planes)
+        {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f)
+                plane /= length;
+        }
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec4 plane = i < 6 ? frustum.planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            frustum.planeX[i] = plane.x;
+            frustum.planeY[i] = plane.y;
+            frustum.planeZ[i] = plane.z;
+            frustum.planeW[i] = plane.w;
+        }
+        return frustum;
+    }
+
+    bool IntersectsSphere(const glm::vec3 &center, float radius) const
+    {
+#ifdef FRUSTUM_SSE
+        __m128 x = _mm_set1_ps(center.x), y = _mm_set1_ps(center.y), z = _mm_set1_ps(center.z);
+        __m128 limit = _mm_set1_ps(-radius);
+        for (int i = 0; i < 8; i += 4)
+        {
+            __m128 distance = planeDistances(i, x, y, z);
+            if (_mm_movemask_ps(_mm_cmplt_ps(distance, limit)) != 0)
+                return false;
+        }
+        return true;
+#else
+        for (const glm::vec4 &plane : planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+#endif
+    }
+
+    // tests the corner furthest along each plane's normal, which may keep a few boxes just outside a corner
+    bool IntersectsBox(const glm::vec3 &minimum, const glm::vec3 &maximum) const
+    {
+#ifdef FRUSTUM_SSE
+        __m128 zero = _mm_setzero_ps();
+        __m128 minimumX = _mm_set1_ps(minimum.x), minimumY = _mm_set1_ps(minimum.y), minimumZ = _mm_set1_ps(minimum.z);
+        __m128 maximumX = _mm_set1_ps(maximum.x), maximumY = _mm_set1_ps(maximum.y), maximumZ = _mm_set1_ps(maximum.z);
+        for (int i = 0; i < 8; i += 4)
+        {
+            __m128 x = furthest(_mm_load_ps(planeX + i), minimumX, maximumX);
+            __m128 y = furthest(_mm_load_ps(planeY + i), minimumY, maximumY);
+            __m128 z = furthest(_mm_load_ps(planeZ + i), minimumZ, maximumZ);
+            if (_mm_movemask_ps(_mm_cmplt_ps(planeDistances(i, x, y, z), zero)) != 0)
+                return false;
+        }
+        return true;
+#else
+        for (const glm::vec4 &plane : planes)
+        {
+            glm::vec3 corner(plane.x > 0.0f ? maximum.x : minimum.x,
+                             plane.y > 0.0f ? maximum.y : minimum.y,
+                             plane.z > 0.0f ? maximum.z : minimum.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+#endif
+    }
+
+    bool Intersects(const Bounds &bounds) const
+    {
+        return IntersectsSphere(bounds.center, bounds.radius) && IntersectsBox(bounds.minimum, bounds.maximum);
+    }
+
+private:
+#ifdef FRUSTUM_SSE
+    // signed distances of a point, or of one point per plane, to planes first to first + 3
+    __m128 planeDistances(int first, __m128 x, __m128 y, __m128 z) const
+    {
+        __m128 distance = _mm_mul_ps(_mm_load_ps(planeX + first), x);
+        distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(planeY + first), y));
+        distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(planeZ + first), z));
+        return _mm_add_ps(distance, _mm_load_ps(planeW + first));
+    }
+
+    // per plane the maximum where its normal component is positive, else the minimum
+    static __m128 furthest(__m128 normal, __m128 minimum, __m128 maximum)
+    {
+        __m128 positive = _mm_cmpgt_ps(normal, _mm_setzero_ps());
+        return _mm_or_ps(_mm_and_ps(positive, maximum), _mm_andnot_ps(positive, minimum));
+    }
+#endif
+};
+
+#endif
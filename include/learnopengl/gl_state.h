@@ -0,0 +1,184 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <iostream>
+using namespace std;
+
+// Shadow copy of the GL state the renderer changes most: program, VAO, texture bindings per unit, and the
+// depth and cull state. Calls that would set what is already set are skipped. Only for the GL thread.
+//
+// Code that changes this state with plain GL calls leaves the copy stale, call Invalidate after it. Everything
+// starts out unknown, so the first call of each kind is always issued.
+class GLState
+{
+public:
+    enum Call {
+        CALL_USE_PROGRAM,
+        CALL_BIND_VERTEX_ARRAY,
+        CALL_ACTIVE_TEXTURE,
+        CALL_BIND_TEXTURE,
+        CALL_ENABLE,
+        CALL_DEPTH_FUNC,
+        CALL_CULL_FACE,
+        CALL_KINDS
+    };
+
+    static const unsigned int TEXTURE_UNITS = 32;
+
+    static GLState &Instance()
+    {
+        static GLState state;
+        return state;
+    }
+
+    // forgets everything, the next call of each kind is issued
+    void Invalidate()
+    {
+        program = vertexArray = activeUnit = UNKNOWN;
+        for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+            textures2D[unit] = texturesCube[unit] = UNKNOWN;
+        depthTest = cullFace = -1;
+        depthFunc = cullFaceMode = UNKNOWN;
+    }
+
+    // deleting a texture unbinds it from every unit, so its id must not count as bound when GL hands it out again
+    void ForgetTexture(unsigned int id)
+    {
+        for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+        {
+            if (textures2D[unit] == id)
+                textures2D[unit] = UNKNOWN;
+            if (texturesCube[unit] == id)
+                texturesCube[unit] = UNKNOWN;
+        }
+    }
+
+    void UseProgram(unsigned int id)
+    {
+        if (!changes(program, id, CALL_USE_PROGRAM))
+            return;
+        glUseProgram(id);
+    }
+
+    void BindVertexArray(unsigned int id)
+    {
+        if (!changes(vertexArray, id, CALL_BIND_VERTEX_ARRAY))
+            return;
+        glBindVertexArray(id);
+    }
+
+    void ActiveTexture(unsigned int unit)
+    {
+        if (!changes(activeUnit, unit, CALL_ACTIVE_TEXTURE))
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds id to target on unit, switching the active unit only if the binding changes. Targets other than 2D
+    // textures and cube maps aren't tracked and always bind.
+    void BindTexture(unsigned int unit, GLenum target, unsigned int id)
+    {
+        unsigned int *bindings = target == GL_TEXTURE_2D ? textures2D : target == GL_TEXTURE_CUBE_MAP ? texturesCube : nullptr;
+        if (bindings && unit < TEXTURE_UNITS && !changes(bindings[unit], id, CALL_BIND_TEXTURE))
+            return;
+        if (!bindings || unit >= TEXTURE_UNITS)
+            counters[CALL_BIND_TEXTURE].issued++;
+        ActiveTexture(unit);
+        glBindTexture(target, id);
+    }
+
+    // GL_DEPTH_TEST and GL_CULL_FACE are tracked, other capabilities always change
+    void Enable(GLenum capability, bool enabled)
+    {
+        int *current = capability == GL_DEPTH_TEST ? &depthTest : capability == GL_CULL_FACE ? &cullFace : nullptr;
+        if (current && *current == (int)enabled)
+        {
+            counters[CALL_ENABLE].elided++;
+            return;
+        }
+        counters[CALL_ENABLE].issued++;
+        if (current)
+            *current = enabled;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    void DepthFunc(GLenum function)
+    {
+        if (!changes(depthFunc, function, CALL_DEPTH_FUNC))
+            return;
+        glDepthFunc(function);
+    }
+
+    void CullFace(GLenum mode)
+    {
+        if (!changes(cullFaceMode, mode, CALL_CULL_FACE))
+            return;
+        glCullFace(mode);
+    }
+
+    // closes the counters of a frame
+    void EndFrame()
+    {
+        for (int call = 0; call < CALL_KINDS; call++)
+        {
+            totals[call].issued += counters[call].issued;
+            totals[call].elided += counters[call].elided;
+            counters[call] = Counter();
+        }
+        frames++;
+    }
+
+    void PrintStats() const
+    {
+        static const char *const names[CALL_KINDS] = {"glUseProgram", "glBindVertexArray", "glActiveTexture", "glBindTexture",
+                                                      "glEnable/glDisable", "glDepthFunc", "glCullFace"};
+        double perFrame = frames > 0 ? 1.0 / frames : 0.0;
+        cout << "GL::STATE " << frames << " frames, calls per frame issued / elided:";
+        for (int call = 0; call < CALL_KINDS; call++)
+            cout << (call ? ", " : " ") << names[call] << " " << totals[call].issued * perFrame << " / " << totals[call].elided * perFrame;
+        cout << endl;
+    }
+
+private:
+    struct Counter {
+        size_t issued = 0;
+        size_t elided = 0;
+    };
+
+    static const unsigned int UNKNOWN = 0xffffffffu;
+
+    unsigned int program, vertexArray, activeUnit;
+    unsigned int textures2D[TEXTURE_UNITS];
+    unsigned int texturesCube[TEXTURE_UNITS];
+    int depthTest, cullFace;            // -1 while unknown
+    GLenum depthFunc, cullFaceMode;
+    Counter counters[CALL_KINDS];       // of the frame in progress
+    Counter totals[CALL_KINDS];
+    size_t frames = 0;
+
+    GLState()
+    {
+        Invalidate();
+    }
+
+    // updates current to value and counts the call, returns false if it was already set
+    bool changes(unsigned int &current, unsigned int value, Call call)
+    {
+        if (current == value)
+        {
+            counters[call].elided++;
+            return false;
+        }
+        current = value;
+        counters[call].issued++;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef INDIRECT_DRAWS_H
+#define INDIRECT_DRAWS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/stream_ring.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// glad is generated for GL 3.3, the GL 4.3 bits the indirect path needs are declared and loaded here
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+// where the *_indirect.vs shaders find the per draw data and the draw index
+const GLuint INDIRECT_DRAW_DATA_BINDING = 0;   // layout (std430, binding = 0) buffer DrawData
+const GLuint INDIRECT_DRAW_ID_LOCATION = 7;    // layout (location = 7) in uint aDrawID
+
+// the layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;      // in indices, not bytes
+    GLint baseVertex;
+    GLuint baseInstance;    // the draw index, see IndirectDraws
+};
+
+// what a draw's vertex shader reads instead of uniforms, std430:
+//   struct Draw { mat4 model; vec4 positionScale; vec4 positionOffset; };
+struct IndirectDrawData {
+    glm::mat4 model;
+    glm::vec4 positionScale;    // dequantization of the positions, 1 and 0 for float positions
+    glm::vec4 positionOffset;
+};
+
+static_assert(sizeof(IndirectDrawData) == 96, "IndirectDrawData must match the std430 layout of Draw");
+
+// GL 4.3 submission path: the frame's draws are collected into indirect commands and per draw data, written to the
+// frame's StreamRing region once, and each run of commands sharing a VAO and textures goes out as a single
+// glMultiDrawElementsIndirect. The vertex shader finds its draw data by the command's baseInstance, which reaches it
+// through an instanced attribute (aDrawID) reading a buffer that holds 0, 1, 2, ... - gl_DrawID would need GL 4.6
+// or ARB_shader_draw_parameters.
+//
+// Only usable when Load found GL 4.3, everything else keeps drawing the GL 3.3 way.
+class IndirectDraws
+{
+public:
+    // checks the context version and loads glMultiDrawElementsIndirect, after glad. Returns whether the path is usable.
+    static bool Load(GLADloadproc load)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 3))
+            multiDrawElementsIndirect() = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+        return Supported();
+    }
+
+    static bool Supported()
+    {
+        return multiDrawElementsIndirect() != nullptr;
+    }
+
+    // must run on the GL thread, after Load
+    void Create()
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        storageAlignment = (size_t)alignment;
+        glGenBuffers(1, &drawIdBuffer);
+    }
+
+    void BeginFrame()
+    {
+        commands.clear();
+        drawData.clear();
+    }
+
+    // returns the index of the new draw, to pass to AddCommand
+    GLuint AddDraw(const IndirectDrawData &data)
+    {
+        drawData.push_back(data);
+        return (GLuint)drawData.size() - 1;
+    }
+
+    // returns the index of the new command. firstIndex is in indices, not bytes.
+    size_t AddCommand(GLuint count, GLuint firstIndex, GLint baseVertex, GLuint draw)
+    {
+        commands.push_back(DrawElementsIndirectCommand{count, 1, firstIndex, baseVertex, draw});
+        return commands.size() - 1;
+    }
+
+    // lets vao's draws find their draw data. Run once per VAO, binds vao.
+    void AttachDrawIds(unsigned int vao)
+    {
+        growDrawIds(1);
+        GLState::Instance().BindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glEnableVertexAttribArray(INDIRECT_DRAW_ID_LOCATION);
+        glVertexAttribIPointer(INDIRECT_DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(INDIRECT_DRAW_ID_LOCATION, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // writes the frame's commands and draw data to ring, after everything was added and before the first Draw.
+    // If the ring is out of room this frame's indirect draws are dropped.
+    void Upload(StreamRing &ring)
+    {
+        stats.frames++;
+        uploaded = false;
+        if (commands.empty())
+            return;
+        growDrawIds(drawData.size());
+        StreamAllocation commandAllocation = ring.Allocate(commands.size() * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+        StreamAllocation drawAllocation = ring.Allocate(drawData.size() * sizeof(IndirectDrawData), storageAlignment);
+        if (!commandAllocation.data || !drawAllocation.data)
+            return;
+        memcpy(commandAllocation.data, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+        memcpy(drawAllocation.data, drawData.data(), drawData.size() * sizeof(IndirectDrawData));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INDIRECT_DRAW_DATA_BINDING, ring.Buffer(), drawAllocation.offset, drawAllocation.size);
+        ringBuffer = ring.Buffer();
+        commandOffset = (size_t)commandAllocation.offset;
+        uploaded = true;
+        stats.commands += commands.size();
+    }
+
+    // issues count commands starting at first as one multi-draw, with the VAO they index bound
+    void Draw(GLenum indexType, size_t first, size_t count)
+    {
+        if (count == 0 || !uploaded)
+            return;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ringBuffer);
+        multiDrawElementsIndirect()(GL_TRIANGLES, indexType,
+                                    (const void *)(commandOffset + first * sizeof(DrawElementsIndirectCommand)), (GLsizei)count, 0);
+        stats.calls++;
+    }
+
+    void PrintStats() const
+    {
+        double frames = stats.frames > 0 ? (double)stats.frames : 1.0;
+        cout << "GL::INDIRECT " << stats.frames << " frames, per frame " << stats.commands / frames << " draw commands in "
+             << stats.calls / frames << " multi-draw calls" << endl;
+    }
+
+    void Delete()
+    {
+        glDeleteBuffers(1, &drawIdBuffer);
+        drawIdBuffer = 0;
+    }
+
+private:
+    struct Stats {
+        size_t frames = 0;
+        size_t commands = 0;
+        size_t calls = 0;
+    };
+
+    vector<DrawElementsIndirectCommand> commands;
+    vector<IndirectDrawData> drawData;
+    // where Upload put the commands
+    bool uploaded = false;
+    unsigned int ringBuffer = 0;
+    size_t commandOffset = 0;
+    size_t storageAlignment = 256;
+    unsigned int drawIdBuffer = 0;
+    size_t drawIds = 0;         // 0, 1, 2, ... in drawIdBuffer
+    Stats stats;
+
+    static MultiDrawElementsIndirectProc &multiDrawElementsIndirect()
+    {
+        static MultiDrawElementsIndirectProc function = nullptr;
+        return function;
+    }
+
+    // makes drawIdBuffer count up to at least draws, the VAOs pointing at it see the new storage
+    void growDrawIds(size_t draws)
+    {
+        if (draws <= drawIds)
+            return;
+        drawIds = max(draws, max<size_t>(drawIds * 2, 1024));
+        vector<GLuint> ids(drawIds);
+        for (size_t i = 0; i < drawIds; i++)
+            ids[i] = (GLuint)i;
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif
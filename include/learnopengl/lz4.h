@@ -0,0 +1,146 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), compatible with the reference
+// decoder. The compressor is the plain greedy one: it trades some ratio for being short, decompression speed is
+// the same either way.
+//
+// a block is a list of sequences: token (literal length, match length - 4), extra literal length bytes, literals,
+// 16 bit little endian offset, extra match length bytes. The last sequence has literals only.
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5;     // the last bytes of a block are always literals
+const size_t LZ4_MATCH_LIMIT = 12;      // and no match starts this close to its end
+const size_t LZ4_MAX_OFFSET = 65535;
+const int LZ4_HASH_BITS = 16;
+
+// worst case size of the compressed block for size input bytes
+size_t Lz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// compresses size bytes of source into destination, which must hold Lz4CompressBound(size) bytes.
+// Returns the compressed size.
+size_t Lz4Compress(const unsigned char *source, size_t size, unsigned char *destination)
+{
+    auto read32 = [source](size_t position)
+    {
+        uint32_t value;
+        memcpy(&value, source + position, sizeof(value));
+        return value;
+    };
+    auto writeLength = [](unsigned char *&out, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            *out++ = 255;
+        *out++ = (unsigned char)length;
+    };
+
+    unsigned char *out = destination;
+    size_t anchor = 0;
+    if (size > LZ4_MATCH_LIMIT)
+    {
+        // last position a match may start at
+        size_t matchStartLimit = size - LZ4_MATCH_LIMIT;
+        std::vector<int64_t> positions((size_t)1 << LZ4_HASH_BITS, -1);
+        size_t position = 0;
+        while (position <= matchStartLimit)
+        {
+            uint32_t sequence = read32(position);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+            int64_t candidate = positions[hash];
+            positions[hash] = (int64_t)position;
+            if (candidate < 0 || position - (size_t)candidate > LZ4_MAX_OFFSET || read32((size_t)candidate) != sequence)
+            {
+                position++;
+                continue;
+            }
+
+            size_t length = LZ4_MIN_MATCH;
+            while (position + length < size - LZ4_LAST_LITERALS && source[candidate + length] == source[position + length])
+                length++;
+
+            size_t literals = position - anchor;
+            size_t extraLength = length - LZ4_MIN_MATCH;
+            *out++ = (unsigned char)((literals < 15 ? literals : 15) << 4 | (extraLength < 15 ? extraLength : 15));
+            if (literals >= 15)
+                writeLength(out, literals - 15);
+            memcpy(out, source + anchor, literals);
+            out += literals;
+            size_t offset = position - (size_t)candidate;
+            *out++ = (unsigned char)(offset & 0xff);
+            *out++ = (unsigned char)(offset >> 8);
+            if (extraLength >= 15)
+                writeLength(out, extraLength - 15);
+            position += length;
+            anchor = position;
+        }
+    }
+
+    size_t literals = size - anchor;
+    *out++ = (unsigned char)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15)
+        writeLength(out, literals - 15);
+    memcpy(out, source + anchor, literals);
+    out += literals;
+    return (size_t)(out - destination);
+}
+
+// decompresses a block that expands to exactly size bytes. Returns false for malformed input instead of reading or
+// writing outside of either buffer.
+bool Lz4Decompress(const unsigned char *source, size_t sourceSize, unsigned char *destination, size_t size)
+{
+    size_t in = 0;
+    size_t out = 0;
+    auto readLength = [&](size_t &length)
+    {
+        unsigned char byte;
+        do
+        {
+            if (in >= sourceSize)
+                return false;
+            byte = source[in++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (in < sourceSize)
+    {
+        unsigned char token = source[in++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals))
+            return false;
+        if (literals > sourceSize - in || literals > size - out)
+            return false;
+        memcpy(destination + out, source + in, literals);
+        in += literals;
+        out += literals;
+        if (in == sourceSize)
+            break;
+
+        if (sourceSize - in < 2)
+            return false;
+        size_t offset = source[in] | (size_t)source[in + 1] << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(length))
+            return false;
+        length += LZ4_MIN_MATCH;
+        if (offset == 0 || offset > out || length > size - out)
+            return false;
+        // matches may overlap what they produce, so they are copied byte by byte
+        const unsigned char *match = destination + out - offset;
+        for (size_t i = 0; i < length; i++)
+            destination[out + i] = match[i];
+        out += length;
+    }
+    return out == size;
+}
+
+#endif
@@ -6,33 +6,120 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/gl_state.h>
+#include <learnopengl/meshlet.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
+// what a material texture is for. Shaders sample them as <prefix>texture_<type>N, N counting from 1 per type.
+enum TextureType : uint32_t {
+    TEXTURE_DIFFUSE,
+    TEXTURE_SPECULAR,
+    TEXTURE_NORMAL,
+    TEXTURE_HEIGHT,
+    TEXTURE_TYPES
 };
 
+// sampler name of a texture type, without the number
+inline const char *TextureTypeName(TextureType type)
+{
+    static const char *const names[TEXTURE_TYPES] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+    return type < TEXTURE_TYPES ? names[type] : "texture_unknown";
+}
 
+// every material sampler has a texture unit of its own: texture_diffuse1 is on unit 0, texture_diffuse2 on 1, ...,
+// texture_specular1 on MATERIAL_TEXTURES_PER_TYPE and so on, so a program's samplers only have to be set once.
+// Textures past MATERIAL_TEXTURES_PER_TYPE of one type aren't bound.
+const unsigned int MATERIAL_TEXTURES_PER_TYPE = 4;
 
 struct Texture {
     unsigned int id;
-    string type;
+    TextureType type;
     string path;
 };
 
+// a texture of a mesh and the unit it is bound to for drawing
+struct TextureBinding {
+    unsigned int unit;
+    unsigned int texture;
+};
+
+// one detail level of a mesh. The indices of all levels of a mesh are stored back to back, finest first,
+// and index the same vertices.
+struct MeshLod {
+    uint32_t indexCount;
+    float error;        // how far the level may deviate from the full detail surface, in model units
+};
+
+// processed mesh data before it is uploaded. Textures only carry type and path, their ids are resolved on upload.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;   // of all detail levels
+    vector<Texture>      textures;
+    vector<MeshLod>      lods;      // empty if indices are all full detail
+    vector<Meshlet>      meshlets;  // clusters of the full detail level, empty if it wasn't split
+};
+
+// non-owning view of processed mesh data, either a MeshData or a region of a memory-mapped mesh cache.
+struct MeshView {
+    const Vertex *vertices;
+    uint32_t vertexCount;
+    const unsigned int *indices;
+    uint32_t indexCount;
+    vector<Texture> textures;
+    vector<MeshLod> lods;
+    vector<Meshlet> meshlets;
+};
+
+// one vertex and one index buffer holding several meshes, and the VAO they are all drawn from.
+// Meshes are appended in order and draw with a base vertex and an index offset into it.
+struct MeshBuffers {
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    VertexFormat format;
+    size_t vertexCapacity = 0;
+    size_t indexCapacity = 0;   // in bytes, indices may be 16 or 32 bit
+    size_t vertexCount = 0;     // appended so far
+    size_t indexBytes = 0;
+
+    // creates the buffers with room for the given number of vertices in format and bytes of indices.
+    // Must run on the GL thread.
+    void Allocate(const VertexFormat &format, size_t vertices, size_t indexBytes)
+    {
+        this->format = format;
+        vertexCapacity = vertices;
+        indexCapacity = indexBytes;
+        vertexCount = this->indexBytes = 0;
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        GLState::Instance().BindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices * format.stride, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+        format.SetAttributes();
+        GLState::Instance().BindVertexArray(0);
+    }
+
+    void Delete()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
+};
+
 class Mesh {
 public:
     // mesh Data
@@ -41,99 +128,247 @@ public:
     vector<Texture>      textures;
 
     unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
+    // where the mesh starts in the buffers of VAO, which are shared with other meshes for meshes of a Model
+    GLint baseVertex = 0;
+    size_t indexOffset = 0;     // in bytes
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    // detail levels, the first one is the full mesh drawn with indexOffset and indexCount
+    vector<MeshLod> lods;
+    vector<size_t> lodIndexOffsets;
+    // clusters of the full detail level, for culling parts of the mesh
+    vector<Meshlet> meshlets;
+    std::string glslIdentifierPrefix;   // set with SetShaderTextureNamePrefix
+    // textures by unit, worked out from textures once
+    vector<TextureBinding> textureBindings;
+    // bounding box and sphere in model space
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    // constructor, pass the data with std::move to hand it over without copies
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+        setLods({});
+        computeBounds(this->vertices.data(), this->vertices.size());
+        setTextureBindings();
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // constructor for data we don't own, e.g. a memory-mapped mesh cache. The buffers are uploaded straight from it,
+    // a CPU copy is only kept in vertices and indices with keepData.
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures,
+         bool keepData = true)
+        : textures(std::move(textures))
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        if (keepData)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            vertices.assign(vertexData, vertexData + vertexCount);
+            indices.assign(indexData, indexData + indexCount);
         }
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+        setLods({});
+        computeBounds(vertexData, vertexCount);
+        setTextureBindings();
+    }
 
+    // same as above, appending the data to buffers shared with other meshes instead of creating buffers of its own.
+    // packedVertices holds the vertices in the format of buffers, packedIndices the indices as indexType.
+    Mesh(MeshBuffers &buffers, const MeshView &data, const void *packedVertices, const void *packedIndices, GLenum indexType,
+         vector<Texture> textures, bool keepData = true)
+        : textures(std::move(textures)), VAO(buffers.VAO), baseVertex((GLint)buffers.vertexCount),
+          indexOffset(AlignedIndexOffset(buffers.indexBytes, indexType)), indexCount((GLsizei)data.indexCount),
+          indexType(indexType), VBO(buffers.VBO), EBO(buffers.EBO)
+    {
+        if (keepData)
+        {
+            vertices.assign(data.vertices, data.vertices + data.vertexCount);
+            indices.assign(data.indices, data.indices + data.indexCount);
+        }
+        GLsizeiptr stride = buffers.format.stride;
+        glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, buffers.vertexCount * stride, data.vertexCount * stride, packedVertices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        // the element buffer binding is VAO state, so the VAO is bound for the upload
+        size_t indexBytes = data.indexCount * IndexSize(indexType);
+        GLState::Instance().BindVertexArray(buffers.VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexOffset, indexBytes, packedIndices);
+        GLState::Instance().BindVertexArray(0);
+        buffers.vertexCount += data.vertexCount;
+        buffers.indexBytes = indexOffset + indexBytes;
+        setLods(data.lods);
+        meshlets = data.meshlets;
+        computeBounds(data.vertices, data.vertexCount);
+        setTextureBindings();
+    }
 
+    static size_t IndexSize(GLenum indexType)
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // indices have to start at a multiple of their size
+    static size_t AlignedIndexOffset(size_t offset, GLenum indexType)
+    {
+        size_t size = IndexSize(indexType);
+        return (offset + size - 1) / size * size;
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // frees the CPU copy of the vertex and index data, the GL buffers are all drawing needs
+    void ReleaseCpuData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // render the mesh
+    void Draw(Shader &shader)
+    {
+        BindTextures(shader);
+
+        // draw mesh, the GLState keeps track of what is bound so nothing needs to be set back
+        GLState::Instance().BindVertexArray(VAO);
+        DrawElements();
+    }
+
+    // issues the draw call alone, with the mesh's VAO already bound. Levels past the coarsest one draw that.
+    void DrawElements(size_t lod = 0) const
+    {
+        lod = std::min(lod, lods.size() - 1);
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)lods[lod].indexCount, indexType, (void*)lodIndexOffsets[lod], baseVertex);
+    }
+
+    bool SameTextures(const Mesh &other) const
+    {
+        if (textures.size() != other.textures.size())
+            return false;
+        for (size_t i = 0; i < textures.size(); i++)
+            if (textures[i].id != other.textures[i].id || textures[i].type != other.textures[i].type)
+                return false;
+        return true;
+    }
+
+    // binds the textures to their units, with shader in use. The first time the mesh is drawn with a shader, its
+    // samplers are pointed at those units.
+    void BindTextures(Shader &shader)
+    {
+        if (std::find(samplerPrograms.begin(), samplerPrograms.end(), shader.ID) == samplerPrograms.end())
+            setSamplers(shader);
+        for (const TextureBinding &binding : textureBindings)
+            GLState::Instance().BindTexture(binding.unit, GL_TEXTURE_2D, binding.texture);
+    }
+
+    void SetShaderTextureNamePrefix(const std::string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        samplerPrograms.clear();
     }
 
 private:
     // render data
     unsigned int VBO, EBO;
+    // programs whose samplers were set for this mesh's textures
+    vector<unsigned int> samplerPrograms;
+
+    // unit of the number-th texture of type, counting from 0
+    static unsigned int textureUnit(TextureType type, unsigned int number)
+    {
+        return (unsigned int)type * MATERIAL_TEXTURES_PER_TYPE + number;
+    }
+
+    // calls back with the unit and number of every texture that gets bound
+    template <typename F>
+    void forEachBoundTexture(F f) const
+    {
+        unsigned int numbers[TEXTURE_TYPES] = {0};
+        for (const Texture &texture : textures)
+        {
+            if (texture.type >= TEXTURE_TYPES || numbers[texture.type] >= MATERIAL_TEXTURES_PER_TYPE)
+                continue;
+            unsigned int number = numbers[texture.type]++;
+            f(texture, textureUnit(texture.type, number), number);
+        }
+    }
+
+    void setTextureBindings()
+    {
+        textureBindings.clear();
+        forEachBoundTexture([this](const Texture &texture, unsigned int unit, unsigned int)
+        {
+            textureBindings.push_back(TextureBinding{unit, texture.id});
+        });
+        samplerPrograms.clear();
+    }
+
+    // sampler uniforms live in the program, so this only has to happen once per program
+    void setSamplers(Shader &shader)
+    {
+        shader.use();
+        forEachBoundTexture([this, &shader](const Texture &texture, unsigned int unit, unsigned int number)
+        {
+            shader.setInt(glslIdentifierPrefix + TextureTypeName(texture.type) + std::to_string(number + 1), (int)unit);
+        });
+        samplerPrograms.push_back(shader.ID);
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
+        this->indexCount = (GLsizei)indexCount;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::Instance().BindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        VertexFormat::Full().SetAttributes();
+
+        GLState::Instance().BindVertexArray(0);
+    }
+
+    void setLods(const vector<MeshLod> &levels)
+    {
+        lods = levels.empty() ? vector<MeshLod>{MeshLod{(uint32_t)indexCount, 0.0f}} : levels;
+        indexCount = (GLsizei)lods[0].indexCount;
+        lodIndexOffsets.clear();
+        size_t offset = indexOffset;
+        for (const MeshLod &lod : lods)
+        {
+            lodIndexOffsets.push_back(offset);
+            offset += lod.indexCount * IndexSize(indexType);
+        }
+    }
+
+    // the bounding box, and a sphere around its center, not the tightest one but good enough to estimate screen size
+    void computeBounds(const Vertex *vertexData, size_t vertexCount)
+    {
+        boundsMin = boundsMax = boundsCenter = glm::vec3(0.0f);
+        boundsRadius = 0.0f;
+        if (vertexCount == 0)
+            return;
+        boundsMin = boundsMax = vertexData[0].Position;
+        for (size_t i = 1; i < vertexCount; i++)
+        {
+            boundsMin = glm::min(boundsMin, vertexData[i].Position);
+            boundsMax = glm::max(boundsMax, vertexData[i].Position);
+        }
+        boundsCenter = (boundsMin + boundsMax) * 0.5f;
+        for (size_t i = 0; i < vertexCount; i++)
+            boundsRadius = glm::max(boundsRadius, glm::length(vertexData[i].Position - boundsCenter));
     }
 };
 #endif
\ No newline at end of file
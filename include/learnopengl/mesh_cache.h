@@ -0,0 +1,317 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/asset_archive.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Binary cache of the processed mesh data of a model (vertices, indices and texture references), so warm
+// startups can skip the Assimp import entirely. One file per source model lives in MESH_CACHE_DIRECTORY.
+//
+// file layout (all payloads 8 byte aligned):
+//   MeshCacheHeader, source path
+//   per dependency: MeshCacheDependency, path
+//   per mesh: MeshCacheEntry, texture references (type, path), MeshLod[lodCount], Meshlet[meshletCount],
+//             Vertex[vertexCount], unsigned int[indexCount] (the indices of all detail levels)
+//
+// A cache file is only used when the version, the import flags, the vertex components Assimp removed, sizeof(Vertex)
+// and the size and mtime of the source file and of every other file the import read, like its material library
+// (as packed, for assets in the archive), all match. Otherwise the model is imported again and the cache file is
+// rewritten.
+const char *const MESH_CACHE_DIRECTORY = "resources/cache";
+const uint32_t MESH_CACHE_VERSION = 8;
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t vertexSize;
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    double coldLoadMs;     // how long the import took when the cache was written
+    uint32_t meshCount;
+    uint32_t pathLength;
+    uint32_t sourceMeshCount;   // meshes in the source file, before they were merged by material
+    uint32_t removedComponents; // aiComponent flags of what the import dropped, zero in the cached vertices
+    uint32_t dependencyCount;   // files besides the source the import read
+    uint32_t padding;
+};
+
+// a file the import read besides the source, as it was when the cache was written
+struct MeshCacheDependency {
+    int64_t mtime;
+    uint64_t size;
+};
+
+struct MeshCacheEntry {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t padding;
+};
+
+class MeshCache
+{
+public:
+    // global switch, e.g. for measuring cold loads
+    static bool &Enabled()
+    {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    // maps the cache file of the given source model. Returns false if there is no usable cache for it.
+    // the views in meshes point into the mapping and stay valid as long as this object lives.
+    bool Load(const string &sourcePath, uint32_t importFlags, uint32_t removedComponents)
+    {
+        meshes.clear();
+        coldLoadMs = 0.0;
+        sourceMeshCount = 0;
+        if (!Enabled())
+            return false;
+
+        int64_t sourceMtime;
+        uint64_t sourceSize;
+        if (!AssetArchive::Instance().Stat(sourcePath, sourceMtime, sourceSize))
+            return false;
+        if (!file.Open(cacheFileFor(sourcePath, importFlags, removedComponents)))
+            return false;
+
+        size_t offset = 0;
+        const MeshCacheHeader *header = read<MeshCacheHeader>(offset);
+        if (!header || std::memcmp(header->magic, "RGMC", 4) != 0 || header->version != MESH_CACHE_VERSION
+            || header->importFlags != importFlags || header->removedComponents != removedComponents
+            || header->vertexSize != sizeof(Vertex)
+            || header->sourceMtime != sourceMtime || header->sourceSize != sourceSize)
+            return invalidate();
+
+        const char *path = readArray<char>(offset, header->pathLength);
+        if (!path || sourcePath.compare(0, string::npos, path, header->pathLength) != 0)
+            return invalidate();
+
+        for (uint32_t i = 0; i < header->dependencyCount; i++)
+        {
+            const MeshCacheDependency *dependency = read<MeshCacheDependency>(offset);
+            string dependencyPath;
+            int64_t mtime;
+            uint64_t size;
+            if (!dependency || !readString(offset, dependencyPath)
+                || !AssetArchive::Instance().Stat(dependencyPath, mtime, size)
+                || dependency->mtime != mtime || dependency->size != size)
+                return invalidate();
+        }
+
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const MeshCacheEntry *entry = read<MeshCacheEntry>(offset);
+            if (!entry)
+                return invalidate();
+            MeshView mesh;
+            for (uint32_t t = 0; t < entry->textureCount; t++)
+            {
+                Texture texture;
+                texture.id = 0;
+                const uint32_t *type = read<uint32_t>(offset);
+                if (!type || *type >= TEXTURE_TYPES || !readString(offset, texture.path))
+                    return invalidate();
+                texture.type = (TextureType)*type;
+                mesh.textures.push_back(texture);
+            }
+            const MeshLod *lods = readArray<MeshLod>(offset, entry->lodCount);
+            if (entry->lodCount && !lods)
+                return invalidate();
+            mesh.lods.assign(lods, lods + entry->lodCount);
+            const Meshlet *meshlets = readArray<Meshlet>(offset, entry->meshletCount);
+            if (entry->meshletCount && !meshlets)
+                return invalidate();
+            mesh.meshlets.assign(meshlets, meshlets + entry->meshletCount);
+            mesh.vertexCount = entry->vertexCount;
+            mesh.vertices = readArray<Vertex>(offset, entry->vertexCount);
+            mesh.indexCount = entry->indexCount;
+            mesh.indices = readArray<unsigned int>(offset, entry->indexCount);
+            if ((entry->vertexCount && !mesh.vertices) || (entry->indexCount && !mesh.indices))
+                return invalidate();
+            meshes.push_back(mesh);
+        }
+        coldLoadMs = header->coldLoadMs;
+        sourceMeshCount = header->sourceMeshCount;
+        return true;
+    }
+
+    // unmaps the cache file, the views in meshes are gone with it
+    void Close()
+    {
+        invalidate();
+    }
+
+    // writes the processed meshes of a freshly imported model. Written to a temporary file first and renamed,
+    // so a crash half way through never leaves a truncated cache behind.
+    // dependencies are the other files the import read, which invalidate the cache when they change.
+    static bool Store(const string &sourcePath, uint32_t importFlags, uint32_t removedComponents,
+                      const vector<string> &dependencies, const vector<MeshView> &meshes, double coldLoadMs,
+                      uint32_t sourceMeshCount)
+    {
+        if (!Enabled())
+            return false;
+        int64_t sourceMtime;
+        uint64_t sourceSize;
+        if (!AssetArchive::Instance().Stat(sourcePath, sourceMtime, sourceSize))
+            return false;
+        vector<MeshCacheDependency> dependencyStats(dependencies.size());
+        for (size_t i = 0; i < dependencies.size(); i++)
+            if (!AssetArchive::Instance().Stat(dependencies[i], dependencyStats[i].mtime, dependencyStats[i].size))
+                return false;
+        mkdir(MESH_CACHE_DIRECTORY, 0755);
+
+        string cachePath = cacheFileFor(sourcePath, importFlags, removedComponents);
+        string tempPath = cachePath + ".tmp";
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "ERROR::MESH_CACHE:: could not write " << tempPath << std::endl;
+            return false;
+        }
+
+        MeshCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "RGMC", 4);
+        header.version = MESH_CACHE_VERSION;
+        header.importFlags = importFlags;
+        header.removedComponents = removedComponents;
+        header.vertexSize = sizeof(Vertex);
+        header.sourceMtime = sourceMtime;
+        header.sourceSize = sourceSize;
+        header.coldLoadMs = coldLoadMs;
+        header.meshCount = (uint32_t)meshes.size();
+        header.pathLength = (uint32_t)sourcePath.size();
+        header.sourceMeshCount = sourceMeshCount;
+        header.dependencyCount = (uint32_t)dependencies.size();
+        write(out, &header, sizeof(header));
+        write(out, sourcePath.data(), sourcePath.size());
+        for (size_t i = 0; i < dependencies.size(); i++)
+        {
+            write(out, &dependencyStats[i], sizeof(MeshCacheDependency));
+            writeString(out, dependencies[i]);
+        }
+
+        for (const MeshView &mesh : meshes)
+        {
+            MeshCacheEntry entry;
+            entry.vertexCount = mesh.vertexCount;
+            entry.indexCount = mesh.indexCount;
+            entry.textureCount = (uint32_t)mesh.textures.size();
+            entry.lodCount = (uint32_t)mesh.lods.size();
+            entry.meshletCount = (uint32_t)mesh.meshlets.size();
+            entry.padding = 0;
+            write(out, &entry, sizeof(entry));
+            for (const Texture &texture : mesh.textures)
+            {
+                uint32_t type = texture.type;
+                write(out, &type, sizeof(type));
+                writeString(out, texture.path);
+            }
+            write(out, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+            write(out, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+            write(out, mesh.vertices, mesh.vertexCount * sizeof(Vertex));
+            write(out, mesh.indices, mesh.indexCount * sizeof(unsigned int));
+        }
+        out.close();
+        if (!out || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // cache file name for a source model: FNV-1a hash of its path and the import settings, so the same model
+    // imported with different flags keeps one cache file per variant instead of overwriting the other
+    static string cacheFileFor(const string &sourcePath, uint32_t importFlags, uint32_t removedComponents)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](unsigned char c) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        };
+        for (unsigned char c : sourcePath)
+            mix(c);
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            mix((unsigned char)(importFlags >> shift));
+            mix((unsigned char)(removedComponents >> shift));
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+        return string(MESH_CACHE_DIRECTORY) + "/" + name + ".meshcache";
+    }
+
+    vector<MeshView> meshes;
+    double coldLoadMs = 0.0;
+    uint32_t sourceMeshCount = 0;
+
+private:
+    MappedFile file;
+
+    static size_t align(size_t offset) { return (offset + 7) & ~(size_t)7; }
+
+    bool invalidate()
+    {
+        meshes.clear();
+        file.Close();
+        return false;
+    }
+
+    template <typename T>
+    const T *readArray(size_t &offset, size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        if (offset > file.Size() || bytes > file.Size() - offset)
+            return nullptr;
+        const T *result = (const T *)(file.Data() + offset);
+        offset = align(offset + bytes);
+        return result;
+    }
+
+    template <typename T>
+    const T *read(size_t &offset) { return readArray<T>(offset, 1); }
+
+    bool readString(size_t &offset, string &result)
+    {
+        const uint32_t *length = read<uint32_t>(offset);
+        if (!length)
+            return false;
+        const char *chars = readArray<char>(offset, *length);
+        if (!chars)
+            return false;
+        result.assign(chars, *length);
+        return true;
+    }
+
+    static void write(std::ofstream &out, const void *data, size_t bytes)
+    {
+        static const char zeros[8] = {0};
+        out.write((const char *)data, bytes);
+        out.write(zeros, align(bytes) - bytes);
+    }
+
+    static void writeString(std::ofstream &out, const string &value)
+    {
+        uint32_t length = (uint32_t)value.size();
+        write(out, &length, sizeof(length));
+        write(out, value.data(), value.size());
+    }
+};
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// FIFO post-transform cache size the orderings are tuned for and the statistics are measured with
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// average cache miss ratio: transformed vertices per triangle for a FIFO cache of cacheSize entries.
+// 3.0 is no reuse at all, 0.5 is the best a large regular grid can do.
+float AverageCacheMissRatio(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+    // a vertex is in the cache while fewer than cacheSize misses happened since it went in
+    vector<size_t> insertedAt(vertexCount, 0);
+    vector<bool> seen(vertexCount, false);
+    size_t misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (seen[index] && misses - insertedAt[index] < cacheSize)
+            continue;
+        seen[index] = true;
+        insertedAt[index] = misses++;
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// merges vertices that are identical bit for bit. Returns the number of vertices removed.
+size_t DeduplicateVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    struct VertexHash {
+        size_t operator()(const Vertex *vertex) const
+        {
+            const unsigned char *bytes = (const unsigned char *)vertex;
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return (size_t)hash;
+        }
+    };
+    struct VertexEqual {
+        bool operator()(const Vertex *a, const Vertex *b) const
+        {
+            return memcmp(a, b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    unordered_map<const Vertex *, unsigned int, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> merged;
+    merged.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        auto inserted = unique.emplace(&vertices[i], (unsigned int)merged.size());
+        if (inserted.second)
+            merged.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    for (unsigned int &index : indices)
+        index = remap[index];
+    size_t removed = vertices.size() - merged.size();
+    vertices.swap(merged);
+    return removed;
+}
+
+// Tipsify (Sander, Nehab and Barczak, "Fast triangle reordering for vertex locality and reduced overdraw"):
+// fans around a vertex, moving on to the neighbour that is still in the cache and has the fewest live triangles.
+// Returns the reordered indices; clusterStarts receives the triangle at which each run of connected fans starts.
+vector<unsigned int> TipsifyIndices(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize,
+                                    vector<size_t> &clusterStarts)
+{
+    size_t triangleCount = indices.size() / 3;
+    // triangles around each vertex
+    vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index : indices)
+        liveTriangles[index]++;
+    vector<size_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<size_t> filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int corner = 0; corner < 3; corner++)
+            adjacency[filled[indices[t * 3 + corner]]++] = (unsigned int)t;
+
+    vector<size_t> cacheTime(vertexCount, 0);
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> deadEnds;
+    vector<unsigned int> candidates;
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    clusterStarts.clear();
+
+    size_t timestamp = cacheSize + 1;
+    size_t cursor = 0;
+    long fanning = triangleCount > 0 ? 0 : -1;
+    bool restarted = true;
+    while (fanning >= 0)
+    {
+        if (restarted)
+            clusterStarts.push_back(result.size() / 3);
+        candidates.clear();
+        for (size_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[t * 3 + corner];
+                result.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (timestamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timestamp++;
+            }
+            emitted[t] = true;
+        }
+
+        // the candidate that stays in the cache the longest while its remaining fan still fits
+        long next = -1;
+        long bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            long priority = 0;
+            if (timestamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = (long)(timestamp - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+        restarted = next < 0;
+        if (restarted)
+        {
+            // dead end: most recently used vertex with live triangles, else the next one in input order
+            while (!deadEnds.empty() && next < 0)
+            {
+                unsigned int v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0)
+                    next = v;
+            }
+            while (next < 0 && cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                    next = (long)cursor;
+                cursor++;
+            }
+        }
+        fanning = next;
+    }
+    return result;
+}
+
+// orders the clusters of a vertex cache optimized index list so that those facing outwards from the mesh center
+// come first. They tend to occlude the rest from most view points, which cuts overdraw without a view direction.
+void SortClustersForOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, const vector<size_t> &clusterStarts)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (clusterStarts.size() < 2 || triangleCount == 0)
+        return;
+
+    glm::vec3 meshCenter(0.0f);
+    for (const Vertex &vertex : vertices)
+        meshCenter += vertex.Position;
+    meshCenter /= (float)max<size_t>(vertices.size(), 1);
+
+    struct Cluster {
+        size_t first;
+        size_t count;
+        float facing;
+    };
+    vector<Cluster> clusters;
+    for (size_t c = 0; c < clusterStarts.size(); c++)
+    {
+        size_t first = clusterStarts[c];
+        size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = first; t < end; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &p = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 weighted = glm::cross(b - a, p - a);  // length is twice the area
+            float triangleArea = glm::length(weighted);
+            center += (a + b + p) * (triangleArea / 3.0f);
+            normal += weighted;
+            area += triangleArea;
+        }
+        if (area > 0.0f)
+            center /= area;
+        float normalLength = glm::length(normal);
+        float facing = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+        clusters.push_back(Cluster{first, end - first, facing});
+    }
+    stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.facing > b.facing; });
+
+    vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for (const Cluster &cluster : clusters)
+        sorted.insert(sorted.end(), indices.begin() + cluster.first * 3, indices.begin() + (cluster.first + cluster.count) * 3);
+    indices.swap(sorted);
+}
+
+// renumbers the vertices in the order the indices first use them, so vertex fetches walk through memory.
+// Vertices no index uses are dropped.
+void ReorderVerticesForFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+struct MeshOptimizationStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+};
+
+// the whole import-time pass: dedupe, vertex cache order, overdraw order, fetch order.
+MeshOptimizationStats OptimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    MeshOptimizationStats stats;
+    stats.verticesBefore = vertices.size();
+    stats.acmrBefore = AverageCacheMissRatio(indices, vertices.size());
+    if (indices.size() % 3 == 0 && !indices.empty())
+    {
+        DeduplicateVertices(vertices, indices);
+        vector<size_t> clusterStarts;
+        indices = TipsifyIndices(indices, vertices.size(), VERTEX_CACHE_SIZE, clusterStarts);
+        SortClustersForOverdraw(indices, vertices, clusterStarts);
+        ReorderVerticesForFetch(vertices, indices);
+    }
+    stats.verticesAfter = vertices.size();
+    stats.acmrAfter = AverageCacheMissRatio(indices, vertices.size());
+    return stats;
+}
+
+#endif
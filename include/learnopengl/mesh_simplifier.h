@@ -0,0 +1,266 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// detail levels generated per mesh, including the full detail one
+const unsigned int MESH_LOD_LEVELS = 4;
+// each level aims for this fraction of the triangles of the one before
+const float MESH_LOD_REDUCTION = 0.5f;
+// collapses that move the surface further than this fraction of the mesh's bounding radius are never made
+const float MESH_LOD_MAX_ERROR = 0.1f;
+
+// quadric error metric (Garland and Heckbert): sum of squared distances to a set of planes,
+// stored as the upper triangle of a symmetric 4x4 matrix
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+
+    void AddPlane(const glm::vec3 &normal, float distance)
+    {
+        double a = normal.x, b = normal.y, c = normal.z, d = distance;
+        xx += a * a; xy += a * b; xz += a * c; xw += a * d;
+        yy += b * b; yz += b * c; yw += b * d;
+        zz += c * c; zw += c * d;
+        ww += d * d;
+    }
+
+    void Add(const Quadric &other)
+    {
+        xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+        yy += other.yy; yz += other.yz; yw += other.yw;
+        zz += other.zz; zw += other.zw;
+        ww += other.ww;
+    }
+
+    double Error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double error = xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+                     + yy * y * y + 2 * yz * y * z + 2 * yw * y
+                     + zz * z * z + 2 * zw * z
+                     + ww;
+        return error > 0.0 ? error : 0.0;
+    }
+};
+
+// simplifies a triangle list by collapsing edges onto one of their end points, cheapest quadric error first, until
+// it is down to targetIndexCount or every remaining collapse would move the surface by more than maxError.
+// The result indexes the same vertices. Vertices on open borders and on attribute seams (several vertices at one
+// position) stay where they are, so the silhouette of open meshes and the texture layout hold up.
+// error receives the largest deviation any collapse made.
+vector<unsigned int> SimplifyMesh(const vector<Vertex> &vertices, const unsigned int *indices, size_t indexCount,
+                                  size_t targetIndexCount, float maxError, float &error)
+{
+    error = 0.0f;
+    vector<unsigned int> result(indices, indices + indexCount - indexCount % 3);
+    size_t vertexCount = vertices.size();
+    if (result.size() <= targetIndexCount || vertexCount == 0)
+        return result;
+
+    // vertices sharing a position
+    struct PositionHash {
+        size_t operator()(const glm::vec3 &p) const
+        {
+            // adding zero turns -0 into 0, which compares equal but has other bits
+            glm::vec3 position = p + glm::vec3(0.0f);
+            uint32_t bits[3];
+            memcpy(bits, &position[0], sizeof(bits));
+            return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+        }
+    };
+    unordered_map<glm::vec3, unsigned int, PositionHash> byPosition;
+    byPosition.reserve(vertexCount);
+    vector<unsigned int> canonical(vertexCount);
+    vector<unsigned int> copies(vertexCount, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        canonical[v] = byPosition.emplace(vertices[v].Position, (unsigned int)v).first->second;
+        copies[canonical[v]]++;
+    }
+
+    // a directed edge without its opposite is on a border, one that shows up twice is non-manifold
+    unordered_map<uint64_t, unsigned int> edges;
+    edges.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        uint64_t a = canonical[result[i]], b = canonical[result[i - i % 3 + (i + 1) % 3]];
+        edges[a << 32 | b]++;
+    }
+    vector<bool> locked(vertexCount, false);
+    for (size_t v = 0; v < vertexCount; v++)
+        locked[v] = copies[canonical[v]] > 1;
+    for (auto &edge : edges)
+    {
+        uint64_t a = edge.first >> 32, b = edge.first & 0xffffffffu;
+        auto opposite = edges.find(b << 32 | a);
+        if (edge.second > 1 || opposite == edges.end() || opposite->second > 1)
+            locked[a] = locked[b] = true;
+    }
+    for (size_t v = 0; v < vertexCount; v++)
+        locked[v] = locked[v] || locked[canonical[v]];
+
+    vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+        const glm::vec3 &a = vertices[result[t]].Position;
+        const glm::vec3 &b = vertices[result[t + 1]].Position;
+        const glm::vec3 &c = vertices[result[t + 2]].Position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+        normal /= length;
+        for (int corner = 0; corner < 3; corner++)
+            quadrics[result[t + corner]].AddPlane(normal, -glm::dot(normal, a));
+    }
+
+    struct Collapse {
+        double cost;
+        unsigned int from;
+        unsigned int to;
+    };
+    vector<Collapse> collapses;
+    vector<unsigned int> remap(vertexCount);
+    vector<bool> touched(vertexCount);
+    vector<size_t> adjacencyStart(vertexCount + 1);
+    vector<unsigned int> adjacency;
+    double maxCost = (double)maxError * maxError;
+
+    // each pass collapses the cheapest edges whose neighbourhoods don't overlap, so the checks of one never go
+    // stale through another collapse of the same pass
+    while (result.size() > targetIndexCount)
+    {
+        fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+        for (unsigned int index : result)
+            adjacencyStart[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        adjacency.resize(result.size());
+        vector<size_t> filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[filled[result[i]]++] = (unsigned int)(i / 3);
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            unsigned int from = result[i], to = result[i - i % 3 + (i + 1) % 3];
+            for (int direction = 0; direction < 2; direction++, swap(from, to))
+            {
+                if (locked[from])
+                    continue;
+                const glm::vec3 &target = vertices[to].Position;
+                double cost = quadrics[from].Error(target) + quadrics[to].Error(target);
+                if (cost <= maxCost)
+                    collapses.push_back(Collapse{cost, from, to});
+            }
+        }
+        sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+        for (size_t v = 0; v < vertexCount; v++)
+            remap[v] = (unsigned int)v;
+        fill(touched.begin(), touched.end(), false);
+        // every collapse takes out about two triangles
+        size_t wanted = (result.size() - targetIndexCount) / 6 + 1;
+        size_t made = 0;
+        for (const Collapse &collapse : collapses)
+        {
+            if (made >= wanted)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+            // moving from onto to must not flip any of the triangles that stay
+            const glm::vec3 &target = vertices[collapse.to].Position;
+            bool flips = false;
+            for (size_t a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1] && !flips; a++)
+            {
+                const unsigned int *triangle = &result[adjacency[a] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    before[corner] = vertices[triangle[corner]].Position;
+                    after[corner] = triangle[corner] == collapse.from ? target : before[corner];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            for (size_t a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1]; a++)
+                for (int corner = 0; corner < 3; corner++)
+                    touched[result[adjacency[a] * 3 + corner]] = true;
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            error = max(error, (float)sqrt(collapse.cost));
+            made++;
+        }
+        if (made == 0)
+            break;
+
+        // drop the triangles the collapses made degenerate
+        size_t kept = 0;
+        for (size_t t = 0; t < result.size(); t += 3)
+        {
+            unsigned int a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+    }
+    return result;
+}
+
+// simplified versions of a vertex cache optimized mesh, appended to its indices. lods receives the full detail
+// level followed by up to MESH_LOD_LEVELS - 1 coarser ones; generation stops early once a mesh won't simplify
+// any further within MESH_LOD_MAX_ERROR.
+void GenerateLods(const vector<Vertex> &vertices, vector<unsigned int> &indices, vector<MeshLod> &lods)
+{
+    lods.assign(1, MeshLod{(uint32_t)indices.size(), 0.0f});
+    if (vertices.empty())
+        return;
+    glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        minimum = glm::min(minimum, vertex.Position);
+        maximum = glm::max(maximum, vertex.Position);
+    }
+    float maxError = glm::length(maximum - minimum) * 0.5f * MESH_LOD_MAX_ERROR;
+
+    size_t previousStart = 0;
+    while (lods.size() < MESH_LOD_LEVELS)
+    {
+        size_t previousCount = lods.back().indexCount;
+        size_t target = (size_t)(previousCount / 3 * MESH_LOD_REDUCTION) * 3;
+        float error = 0.0f;
+        vector<size_t> clusterStarts;
+        vector<unsigned int> level = SimplifyMesh(vertices, &indices[previousStart], previousCount, target, maxError, error);
+        // a level that barely saves anything isn't worth its memory
+        if (level.empty() || level.size() > previousCount * 0.9f)
+            break;
+        level = TipsifyIndices(level, vertices.size(), VERTEX_CACHE_SIZE, clusterStarts);
+        previousStart = indices.size();
+        indices.insert(indices.end(), level.begin(), level.end());
+        // levels simplify the one before, so their errors add up
+        lods.push_back(MeshLod{(uint32_t)level.size(), lods.back().error + error});
+    }
+}
+
+#endif
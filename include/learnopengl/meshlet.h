@@ -0,0 +1,104 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// clusters take triangles up to the maximum, and once they have the minimum they end where the index order
+// jumps to triangles that share no vertex with them
+const uint32_t MESHLET_MIN_TRIANGLES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 128;
+
+// a run of consecutive triangles of a mesh with the data to cull it on its own. Stored as is in the mesh cache.
+struct Meshlet {
+    uint32_t firstIndex;    // into the full detail indices of the mesh
+    uint32_t indexCount;
+    glm::vec3 center;       // bounding sphere
+    float radius;
+    glm::vec3 boundsMin;    // bounding box
+    glm::vec3 boundsMax;
+    // normal cone: all triangles face away from any eye in the cone around -coneAxis that BackFacing tests for.
+    // coneCutoff is the sine of the cone's half angle, 1 if the normals spread too far to ever cull.
+    glm::vec3 coneAxis;
+    float coneCutoff;
+
+    // every triangle of the cluster faces away from eye. Conservative, it uses the bounding sphere as the apex.
+    bool BackFacing(const glm::vec3 &eye) const
+    {
+        if (coneCutoff >= 1.0f)
+            return false;
+        glm::vec3 toCluster = center - eye;
+        return glm::dot(toCluster, coneAxis) >= coneCutoff * glm::length(toCluster) + radius;
+    }
+};
+
+// splits a vertex cache ordered triangle list into meshlets. The triangles are not reordered, the cache
+// optimization already keeps consecutive triangles close together.
+vector<Meshlet> BuildMeshlets(const vector<Vertex> &vertices, const unsigned int *indices, size_t indexCount)
+{
+    vector<Meshlet> meshlets;
+    size_t triangleCount = indexCount / 3;
+    vector<uint32_t> lastUse(vertices.size(), ~0u);     // meshlet that last used each vertex
+    size_t first = 0;
+    while (first < triangleCount)
+    {
+        uint32_t id = (uint32_t)meshlets.size();
+        size_t end = first;
+        while (end < triangleCount && end - first < MESHLET_MAX_TRIANGLES)
+        {
+            const unsigned int *triangle = &indices[end * 3];
+            bool connected = lastUse[triangle[0]] == id || lastUse[triangle[1]] == id || lastUse[triangle[2]] == id;
+            if (end - first >= MESHLET_MIN_TRIANGLES && !connected)
+                break;
+            lastUse[triangle[0]] = lastUse[triangle[1]] = lastUse[triangle[2]] = id;
+            end++;
+        }
+
+        Meshlet meshlet;
+        meshlet.firstIndex = (uint32_t)first * 3;
+        meshlet.indexCount = (uint32_t)(end - first) * 3;
+        meshlet.boundsMin = meshlet.boundsMax = vertices[indices[first * 3]].Position;
+        glm::vec3 normalSum(0.0f);
+        vector<glm::vec3> normals;
+        normals.reserve(end - first);
+        for (size_t t = first; t < end; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &c = vertices[indices[t * 3 + 2]].Position;
+            meshlet.boundsMin = glm::min(meshlet.boundsMin, glm::min(a, glm::min(b, c)));
+            meshlet.boundsMax = glm::max(meshlet.boundsMax, glm::max(a, glm::max(b, c)));
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+                continue;
+            normals.push_back(normal / length);
+            normalSum += normals.back();
+        }
+        meshlet.center = (meshlet.boundsMin + meshlet.boundsMax) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (size_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+            meshlet.radius = max(meshlet.radius, glm::length(vertices[indices[i]].Position - meshlet.center));
+
+        float sumLength = glm::length(normalSum);
+        meshlet.coneAxis = sumLength > 0.0f ? normalSum / sumLength : glm::vec3(0.0f, 0.0f, 1.0f);
+        float minimumDot = sumLength > 0.0f ? 1.0f : -1.0f;
+        for (const glm::vec3 &normal : normals)
+            minimumDot = min(minimumDot, glm::dot(normal, meshlet.coneAxis));
+        // normals spreading over more than a half sphere can't be culled from anywhere
+        meshlet.coneCutoff = minimumDot <= 0.0f ? 1.0f : sqrt(1.0f - minimumDot * minimumDot);
+        meshlets.push_back(meshlet);
+        first = end;
+    }
+    return meshlets;
+}
+
+#endif
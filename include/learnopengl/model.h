@@ -7,115 +7,923 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
 #include <assimp/Importer.hpp>
+#include <assimp/config.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/archive_io_system.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/indirect_draws.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/process_memory.h>
+#include <learnopengl/projected_size.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/startup_profiler.h>
+#include <learnopengl/texture_manager.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/upload_queue.h>
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// a detail level is good enough while it deviates from the full mesh by at most this many pixels on screen
+const float MODEL_LOD_PIXEL_ERROR = 1.0f;
+// a model only switches to a coarser level once its error is this much below the limit, and back to a finer one
+// once it is this much above, so models at the edge don't flicker between two levels
+const float MODEL_LOD_HYSTERESIS = 0.25f;
 
+// post-processing applied by Assimp on every import
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+// post-processing for a model drawn with the given inputs: vertex components the shader doesn't read are dropped
+// by Assimp and never generated, computed or stored. Part of the mesh cache key with ModelRemovedComponents, so
+// changing either invalidates the cache.
+unsigned int ModelImportFlags(const VertexInputs &inputs)
+{
+    unsigned int flags = MODEL_IMPORT_FLAGS | aiProcess_RemoveComponent;
+    if (inputs.NeedsNormals())
+        flags |= aiProcess_GenSmoothNormals;
+    if (inputs.NeedsTangents())
+        flags |= aiProcess_CalcTangentSpace;
+    return flags;
+}
+
+// the components ModelImportFlags has Assimp remove, for AI_CONFIG_PP_RVC_FLAGS. Tangents are generated from the
+// texture coordinates, so those stay for them.
+int ModelRemovedComponents(const VertexInputs &inputs)
+{
+    int components = 0;
+    if (!inputs.NeedsNormals())
+        components |= aiComponent_NORMALS;
+    if (!inputs.NeedsTexCoords() && !inputs.NeedsTangents())
+        components |= aiComponent_TEXCOORDS;
+    if (!inputs.NeedsTangents())
+        components |= aiComponent_TANGENTS_AND_BITANGENTS;
+    return components;
+}
+
+// meshes of one material are merged on import up to this many vertices, so the merged ones keep 16 bit indices
+const uint32_t MODEL_MERGE_MAX_VERTICES = 65536;
+
+
+
+// everything a model load produces off the GL thread, shared between the loader thread and the upload tasks.
+struct ModelImport {
+    vector<MeshData> imported;  // meshes processed by Assimp on a cold load
+    MeshCache cache;            // mapped cache file on a warm load
+    vector<MeshView> meshes;    // views into one of the two above
+    bool warm = false;
+    uint32_t sourceMeshes = 0;  // meshes as the file splits them, before merging by material
+    // vertices as they go into the vertex buffer, empty if the format is Vertex itself
+    VertexFormat format;
+    VertexQuantization quantization;
+    vector<vector<unsigned char>> packedVertices;
+    vector<vector<uint16_t>> packedIndices;     // 16 bit indices of the meshes with few enough vertices, else empty
+    double importMs = 0.0;      // time spent importing, off the GL thread when loading asynchronously
+    double coldMs = 0.0;        // Assimp import time, taken from the cache on warm loads
+
+    // texture decoding, fanned out over the pool once the import is done
+    vector<Texture> textures;              // unique textures referenced by the meshes
+    vector<double> decodeMs;               // per texture, written only by the task decoding it
+    atomic<unsigned int> pendingDecodes{0};
+    chrono::steady_clock::time_point decodeStart;
+    double decodeWallMs = 0.0;
+};
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once. Shared with other models through the TextureManager.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    bool resident;  // set once every mesh is uploaded. Drawing a model that isn't resident yet does nothing.
+    // whether meshes keep their vertices and indices on the CPU after the upload. Set before LoadAsync, drawing
+    // only needs the GL buffers.
+    bool keepMeshData;
+    // whether Cull drops the meshlets outside the view frustum, and also those facing away from the camera. Only
+    // use the latter for models whose back faces are never seen, it culls them whether face culling is on or not.
+    bool clusterCulling;
+    bool coneCulling;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false)
+        : gammaCorrection(gamma), resident(false), keepMeshData(true), clusterCulling(true), coneCulling(false)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
+    // empty model, to be filled by LoadAsync
+    Model() : gammaCorrection(false), resident(false), keepMeshData(true), clusterCulling(true), coneCulling(false)
+    {
+    }
+
+    // imports the model on a worker of pool and queues its GL work on uploads: every texture is decoded by its own
+    // pool task and uploaded as soon as it is decoded, then come the meshes, one upload task per mesh.
+    // Returns immediately; the model becomes resident once the render thread has processed all of its upload tasks.
+    // The model must not be moved or destroyed while any of its tasks are still pending.
+    void LoadAsync(string const &path, ThreadPool &pool, GLUploadQueue &uploads)
+    {
+        auto start = chrono::steady_clock::now();
+        directory = path.substr(0, path.find_last_of('/'));
+        this->path = path;
+        shared_ptr<ModelImport> import = make_shared<ModelImport>();
+        VertexInputs inputs = vertexInputs;
+        pool.Submit([this, path, import, inputs, start, &pool, &uploads]()
+        {
+            {
+                StartupTimer timer("model", "import " + path);
+                importModel(path, inputs, *import);
+            }
+            {
+                StartupTimer timer("model", "pack " + path);
+                packMeshes(*import, inputs);
+            }
+            decodeTextures(path, import, start, pool, uploads);
+        });
+    }
+
+    // draws the model, and thus all its meshes, at the detail level picked by the last SelectLod. They all come
+    // from one VAO, and meshes in a row that use the same textures go out as a single multi-draw.
+    // After a Cull only what survived it is drawn.
     void Draw(Shader &shader)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        if (!resident)
+            return;
+        // float positions go through the dequantization unchanged, the program may still hold another model's
+        bool quantized = buffers.format.quantizedPositions;
+        shader.setVec3("positionScale", quantized ? quantization.scale : glm::vec3(1.0f));
+        shader.setVec3("positionOffset", quantized ? quantization.offset : glm::vec3(0.0f));
+        GLState::Instance().BindVertexArray(buffers.VAO);
+        if (culled)
+        {
+            drawVisible(shader);
+            return;
+        }
+        for (const MeshBatch &batch : batches)
+        {
+            meshes[batch.first].BindTextures(shader);
+            if (batch.count == 1)
+                meshes[batch.first].DrawElements(lod);
+            else
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, &drawCounts[lod][batch.first], meshes[batch.first].indexType,
+                                              &drawOffsets[lod][batch.first], (GLsizei)batch.count, &drawBaseVertices[batch.first]);
+        }
+    }
+
+    // GL 4.3 alternative to Draw: adds what Draw would draw to draws as indirect commands, with model and the position
+    // dequantization in the draw data instead of uniforms. DrawIndirect issues them once draws is uploaded.
+    void SubmitIndirect(IndirectDraws &draws, const glm::mat4 &model)
+    {
+        indirectBatches.clear();
+        if (!resident)
+            return;
+        if (indirectVAO != buffers.VAO)
+        {
+            draws.AttachDrawIds(buffers.VAO);
+            indirectVAO = buffers.VAO;
+        }
+        IndirectDrawData data{model, glm::vec4(1.0f), glm::vec4(0.0f)};
+        if (buffers.format.quantizedPositions)
+        {
+            data.positionScale = glm::vec4(quantization.scale, 0.0f);
+            data.positionOffset = glm::vec4(quantization.offset, 0.0f);
+        }
+        GLuint draw = draws.AddDraw(data);
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            // the ranges Cull left, or all meshes of the batch at the current level
+            MeshBatch ranges = culled ? visibleBatches[b] : batches[b];
+            const GLsizei *counts = culled ? visibleCounts.data() : drawCounts[lod].data();
+            const void *const *offsets = culled ? visibleOffsets.data() : drawOffsets[lod].data();
+            const GLint *baseVertices = culled ? visibleBaseVertices.data() : drawBaseVertices.data();
+            size_t indexSize = Mesh::IndexSize(meshes[batches[b].first].indexType);
+            size_t first = 0;
+            for (size_t i = ranges.first; i < ranges.first + ranges.count; i++)
+            {
+                size_t command = draws.AddCommand((GLuint)counts[i], (GLuint)((size_t)offsets[i] / indexSize), baseVertices[i], draw);
+                if (i == ranges.first)
+                    first = command;
+            }
+            indirectBatches.push_back(MeshBatch{first, ranges.count});
+        }
+        culled = false;
+    }
+
+    // draws what the last SubmitIndirect added, one multi-draw per run of meshes with the same textures
+    void DrawIndirect(IndirectDraws &draws, Shader &shader)
+    {
+        if (!resident || indirectBatches.empty())
+            return;
+        GLState::Instance().BindVertexArray(buffers.VAO);
+        for (size_t b = 0; b < indirectBatches.size(); b++)
+        {
+            if (indirectBatches[b].count == 0)
+                continue;
+            meshes[batches[b].first].BindTextures(shader);
+            draws.Draw(meshes[batches[b].first].indexType, indirectBatches[b].first, indirectBatches[b].count);
+        }
+    }
+
+    // picks the detail level for drawing the model with the given model matrix and camera: the coarsest one whose
+    // error stays below MODEL_LOD_PIXEL_ERROR pixels, with some hysteresis against the level used so far.
+    void SelectLod(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight)
+    {
+        if (!resident || lodErrors.size() < 2)
+            return;
+        float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float pixels = ProjectedSphereSize(glm::vec3(model * glm::vec4(boundsCenter, 1.0f)), boundsRadius * scale,
+                                           view, projection, viewportHeight);
+        if (std::isinf(pixels))
+        {
+            lod = 0;
+            return;
+        }
+        // model units to pixels
+        float pixelsPerUnit = boundsRadius > 0.0f ? pixels / (2.0f * boundsRadius) : 0.0f;
+        auto coarsestWithin = [&](float limit)
+        {
+            size_t level = 0;
+            while (level + 1 < lodErrors.size() && lodErrors[level + 1] * pixelsPerUnit <= limit)
+                level++;
+            return level;
+        };
+        if (lodErrors[lod] * pixelsPerUnit > MODEL_LOD_PIXEL_ERROR * (1.0f + MODEL_LOD_HYSTERESIS))
+            lod = coarsestWithin(MODEL_LOD_PIXEL_ERROR);
+        else
+            lod = max(lod, coarsestWithin(MODEL_LOD_PIXEL_ERROR * (1.0f - MODEL_LOD_HYSTERESIS)));
+    }
+
+    size_t Lod() const { return lod; }
+
+    // box and sphere around all meshes, in world space for drawing with the given model matrix
+    Bounds WorldBounds(const glm::mat4 &model) const
+    {
+        return Bounds{boundsMin, boundsMax, boundsCenter, boundsRadius}.Transformed(model);
+    }
+
+    // culls the model for the next Draw with the given model matrix and camera. Meshes outside the view frustum are
+    // left out, and at full detail so are their meshlets outside of it or, with coneCulling, facing away from the
+    // camera. The surviving runs of each batch go out as one multi-draw.
+    void Cull(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        culled = false;
+        meshVisibility = VisibilityCounts();
+        if (!resident)
+            return;
+        if (!clusterCulling)
+        {
+            meshVisibility.visible = meshes.size();
+            return;
+        }
+        // planes and eye in model space, so the mesh and meshlet bounds are tested as they are
+        Frustum frustum = Frustum::FromMatrix(projection * view * model);
+        glm::vec3 eye = glm::vec3(glm::inverse(view * model)[3]);
+        visibleBatches.clear();
+        visibleCounts.clear();
+        visibleOffsets.clear();
+        visibleBaseVertices.clear();
+        cullStats.frames++;
+        for (const MeshBatch &batch : batches)
+        {
+            size_t first = visibleCounts.size();
+            for (size_t i = batch.first; i < batch.first + batch.count; i++)
+            {
+                const Mesh &mesh = meshes[i];
+                size_t clusters = lod == 0 ? mesh.meshlets.size() : 0;
+                cullStats.clusters += clusters;
+                bool visible = frustum.IntersectsSphere(mesh.boundsCenter, mesh.boundsRadius) &&
+                               frustum.IntersectsBox(mesh.boundsMin, mesh.boundsMax);
+                meshVisibility.Count(visible);
+                if (!visible)
+                {
+                    cullStats.meshesCulled++;
+                    cullStats.frustumCulled += clusters;
+                    continue;
+                }
+                if (clusters == 0)
+                {
+                    addVisibleRange(drawCounts[lod][i], drawOffsets[lod][i], mesh.baseVertex, false);
+                    continue;
+                }
+                size_t indexSize = Mesh::IndexSize(mesh.indexType);
+                bool continues = false;     // the last meshlet of this mesh was drawn, the next one may extend its range
+                for (const Meshlet &meshlet : mesh.meshlets)
+                {
+                    bool visible = false;
+                    if (!frustum.IntersectsSphere(meshlet.center, meshlet.radius) || !frustum.IntersectsBox(meshlet.boundsMin, meshlet.boundsMax))
+                        cullStats.frustumCulled++;
+                    else if (coneCulling && meshlet.BackFacing(eye))
+                        cullStats.coneCulled++;
+                    else
+                        visible = true;
+                    if (visible)
+                        addVisibleRange((GLsizei)meshlet.indexCount, (const void *)(mesh.indexOffset + meshlet.firstIndex * indexSize),
+                                        mesh.baseVertex, continues);
+                    continues = visible;
+                }
+            }
+            visibleBatches.push_back(MeshBatch{first, visibleCounts.size() - first});
+        }
+        culled = true;
+    }
+
+    // meshes the last Cull kept and dropped
+    const VisibilityCounts &MeshVisibility() const { return meshVisibility; }
+
+    // how many meshlets Cull dropped since the model was loaded
+    void PrintCullStats() const
+    {
+        double clusters = (double)max<size_t>(cullStats.clusters, 1);
+        cout << "MODEL::CULLING " << path << " " << cullStats.clusters << " meshlets tested over " << cullStats.frames << " frames, "
+             << 100.0 * cullStats.frustumCulled / clusters << "% outside the frustum, " << 100.0 * cullStats.coneCulled / clusters
+             << "% facing away, " << cullStats.meshesCulled << " whole meshes culled" << endl;
+    }
+
+    // triangles one Draw renders at the current detail level
+    size_t DrawnTriangles() const
+    {
+        size_t triangles = 0;
+        for (const Mesh &mesh : meshes)
+            triangles += mesh.lods[min(lod, mesh.lods.size() - 1)].indexCount / 3;
+        return triangles;
+    }
+
+    // tells streamer how large the textures of each mesh show up on screen this frame, given the model matrix the
+    // model is drawn with. Meshes behind the camera don't ask for anything.
+    void RequestTextureDetail(TextureStreamer &streamer, const glm::mat4 &model) const
+    {
+        if (!resident)
+            return;
+        float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        for (const Mesh &mesh : meshes)
+        {
+            float pixels = streamer.ProjectedSize(glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f)), mesh.boundsRadius * scale);
+            for (const Texture &texture : mesh.textures)
+                streamer.Request(texture.id, pixels);
+        }
+    }
+
+    // vertices are stored with just the attributes these inputs read, in the smallest encoding that suits them.
+    // Set before LoadAsync, usually to VertexInputs::Of the shader the model is drawn with.
+    void SetVertexInputs(const VertexInputs &inputs)
+    {
+        vertexInputs = inputs;
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
+        glslIdentifierPrefix = prefix;
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetShaderTextureNamePrefix(prefix);
         }
     }
+    // frees the CPU copies of the mesh data of a model that was loaded with keepMeshData
+    void ReleaseMeshData()
+    {
+        for (Mesh &mesh : meshes)
+            mesh.ReleaseCpuData();
+    }
+
+    // gives the model's references to its textures back to the TextureManager and deletes its vertex and index
+    // buffers. Must run on the GL thread.
+    void Release()
+    {
+        for (const Texture &texture : textures_loaded)
+            TextureManager::Instance().Release(texture.id);
+        textures_loaded.clear();
+        loadedIndex.clear();
+        buffers.Delete();
+    }
+
+    // models hand `this` to their loader tasks and hold texture references, so they are never copied
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
 private:
+    // consecutive meshes drawn with the same textures
+    struct MeshBatch {
+        size_t first;
+        size_t count;
+    };
+
+    // meshlets tested and culled by Cull, summed over all frames
+    struct CullStats {
+        size_t frames = 0;
+        size_t clusters = 0;
+        size_t frustumCulled = 0;
+        size_t coneCulled = 0;
+        size_t meshesCulled = 0;
+    };
+
+    string path;
+    std::string glslIdentifierPrefix;
+    unordered_map<string, size_t> loadedIndex;   // path -> index in textures_loaded
+    MeshBuffers buffers;                         // vertices and indices of all meshes
+    VertexInputs vertexInputs;
+    VertexQuantization quantization;             // of the positions in buffers, if they are quantized
+    vector<MeshBatch> batches;
+    // per detail level and mesh draw arguments, laid out for glMultiDrawElementsBaseVertex
+    vector<vector<GLsizei>> drawCounts;
+    vector<vector<const void *>> drawOffsets;
+    vector<GLint> drawBaseVertices;
+    // detail levels: the largest error of any mesh at each level, and the level drawn
+    vector<float> lodErrors;
+    size_t lod = 0;
+    // bounding box and sphere of all meshes in model space
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    // what the last Cull left to draw: per batch a run of ranges in the per range draw arguments
+    bool culled = false;
+    vector<MeshBatch> visibleBatches;
+    // per batch the commands of the last SubmitIndirect, and the VAO that has the draw ids attached
+    vector<MeshBatch> indirectBatches;
+    unsigned int indirectVAO = 0;
+    vector<GLsizei> visibleCounts;
+    vector<const void *> visibleOffsets;
+    vector<GLint> visibleBaseVertices;
+    CullStats cullStats;
+    VisibilityCounts meshVisibility;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // same as LoadAsync, with the calling thread doing the uploads and waiting for them.
     void loadModel(string const &path)
     {
+        GLUploadQueue uploads;
+        ThreadPool pool;
+        LoadAsync(path, pool, uploads);
+        while (!resident)
+        {
+            uploads.WaitForWork();
+            uploads.Process(numeric_limits<double>::infinity());
+        }
+    }
+
+    // produces the processed meshes of a model without touching GL, so it can run on any thread. Only the vertex
+    // components inputs reads are imported, the others are left zero.
+    // the processed meshes are cached on disk, so later runs skip Assimp and use the memory-mapped cache file.
+    static void importModel(string const &path, const VertexInputs &inputs, ModelImport &import)
+    {
+        auto start = chrono::steady_clock::now();
+        unsigned int flags = ModelImportFlags(inputs);
+        int removedComponents = ModelRemovedComponents(inputs);
+        if (import.cache.Load(path, flags, (uint32_t)removedComponents))
+        {
+            import.meshes = import.cache.meshes;
+            import.sourceMeshes = import.cache.sourceMeshCount;
+            import.warm = true;
+            import.coldMs = import.cache.coldLoadMs;
+            import.importMs = millisecondsSince(start);
+            return;
+        }
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        // reads the model and its materials from the asset archive or the loose files, the importer owns it
+        ArchiveIOSystem *files = new ArchiveIOSystem;
+        importer.SetIOHandler(files);
+        importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, removedComponents);
+        const aiScene* scene = importer.ReadFile(path, flags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        vector<uint64_t> mergeKeys;
+        unordered_map<uint64_t, size_t> merging;
+        processNode(scene->mRootNode, scene, glm::mat4(1.0f), import.imported, mergeKeys, merging, import.sourceMeshes);
+        sortByMaterial(import.imported, mergeKeys);
+        for (size_t i = 0; i < import.imported.size(); i++)
+        {
+            MeshData &mesh = import.imported[i];
+            MeshOptimizationStats stats = OptimizeMesh(mesh.vertices, mesh.indices);
+            cout << "MESH::OPTIMIZE " << path << " mesh " << i << ": " << stats.verticesBefore << " -> " << stats.verticesAfter
+                 << " vertices, ACMR " << stats.acmrBefore << " -> " << stats.acmrAfter << " (cache of " << VERTEX_CACHE_SIZE << ")" << endl;
+            GenerateLods(mesh.vertices, mesh.indices, mesh.lods);
+            mesh.meshlets = BuildMeshlets(mesh.vertices, mesh.indices.data(), mesh.lods[0].indexCount);
+        }
+        for (const MeshData &mesh : import.imported)
+            import.meshes.push_back(MeshView{mesh.vertices.data(), (uint32_t)mesh.vertices.size(),
+                                             mesh.indices.data(), (uint32_t)mesh.indices.size(), mesh.textures, mesh.lods,
+                                             mesh.meshlets});
+
+        import.importMs = import.coldMs = millisecondsSince(start);
+        // the material libraries and anything else the import read besides the model itself
+        vector<string> dependencies;
+        for (const string &opened : files->Opened())
+            if (opened != path)
+                dependencies.push_back(opened);
+        MeshCache::Store(path, flags, (uint32_t)removedComponents, dependencies, import.meshes, import.coldMs, import.sourceMeshes);
+    }
+
+    // picks the vertex format for the inputs and packs the vertices into it. Positions are quantized to the
+    // bounding box of the whole model, so all of its meshes share one dequantization.
+    // Meshes with up to 65536 vertices get 16 bit indices, the base vertex of their draw takes care of the rest.
+    static void packMeshes(ModelImport &import, const VertexInputs &inputs)
+    {
+        import.packedIndices.resize(import.meshes.size());
+        for (size_t i = 0; i < import.meshes.size(); i++)
+        {
+            const MeshView &mesh = import.meshes[i];
+            if (mesh.vertexCount > 65536 || mesh.indexCount == 0)
+                continue;
+            import.packedIndices[i].assign(mesh.indices, mesh.indices + mesh.indexCount);
+        }
+
+        bool first = true;
+        glm::vec3 minimum(0.0f), maximum(0.0f);
+        float texCoordRange = 0.0f;
+        for (const MeshView &mesh : import.meshes)
+            for (uint32_t i = 0; i < mesh.vertexCount; i++)
+            {
+                const Vertex &vertex = mesh.vertices[i];
+                minimum = first ? vertex.Position : glm::min(minimum, vertex.Position);
+                maximum = first ? vertex.Position : glm::max(maximum, vertex.Position);
+                texCoordRange = glm::max(texCoordRange, glm::max(std::fabs(vertex.TexCoords.x), std::fabs(vertex.TexCoords.y)));
+                first = false;
+            }
+        import.quantization.offset = (minimum + maximum) * 0.5f;
+        import.quantization.scale = glm::max((maximum - minimum) * 0.5f, glm::vec3(1e-6f));
+
+        import.format = VertexFormat::For(inputs, texCoordRange <= HALF_TEXCOORD_LIMIT);
+        if (import.format.IsVertex())
+            return;
+        import.packedVertices.resize(import.meshes.size());
+        for (size_t i = 0; i < import.meshes.size(); i++)
+        {
+            const MeshView &mesh = import.meshes[i];
+            import.packedVertices[i].resize((size_t)mesh.vertexCount * import.format.stride);
+            import.format.Pack(mesh.vertices, mesh.vertexCount, import.quantization, import.packedVertices[i].data());
+        }
+    }
+
+    // acquires all textures of an import from the TextureManager on the pool, which decodes the ones it doesn't
+    // know yet. Each acquired texture gets an upload task, and the task that
+    // finishes the last decode queues the meshes behind those uploads, so their textures are resident when they
+    // are created.
+    void decodeTextures(string const &path, shared_ptr<ModelImport> import, chrono::steady_clock::time_point start,
+                        ThreadPool &pool, GLUploadQueue &uploads)
+    {
+        for (const MeshView &mesh : import->meshes)
+            for (const Texture &texture : mesh.textures)
+            {
+                bool seen = false;
+                for (const Texture &unique : import->textures)
+                    seen = seen || unique.path == texture.path;
+                if (!seen)
+                    import->textures.push_back(texture);
+            }
+
+        if (import->textures.empty())
+        {
+            queueMeshUploads(path, import, start, uploads);
+            return;
+        }
+        import->decodeMs.resize(import->textures.size());
+        import->pendingDecodes = (unsigned int)import->textures.size();
+        import->decodeStart = chrono::steady_clock::now();
+        string directory = this->directory;
+        for (size_t i = 0; i < import->textures.size(); i++)
+        {
+            pool.Submit([this, path, import, start, i, directory, &uploads]()
+            {
+                auto decodeStart = chrono::steady_clock::now();
+                shared_ptr<TextureEntry> entry = TextureManager::Instance().Acquire(directory + '/' + import->textures[i].path);
+                import->decodeMs[i] = millisecondsSince(decodeStart);
+                uploads.Push([this, import, i, entry]()
+                {
+                    Texture texture = import->textures[i];
+                    texture.id = TextureManager::Instance().Resolve(entry);
+                    addLoadedTexture(texture);
+                });
+                if (--import->pendingDecodes == 0)
+                {
+                    import->decodeWallMs = millisecondsSince(import->decodeStart);
+                    queueMeshUploads(path, import, start, uploads);
+                }
+            });
+        }
+    }
+
+    void queueMeshUploads(string const &path, shared_ptr<ModelImport> import, chrono::steady_clock::time_point start,
+                          GLUploadQueue &uploads)
+    {
+        uploads.Push([this, import]()
+        {
+            size_t vertexCount = 0;
+            size_t indexBytes = 0;
+            for (size_t i = 0; i < import->meshes.size(); i++)
+            {
+                GLenum indexType = import->packedIndices[i].empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+                vertexCount += import->meshes[i].vertexCount;
+                indexBytes = Mesh::AlignedIndexOffset(indexBytes, indexType) + import->meshes[i].indexCount * Mesh::IndexSize(indexType);
+            }
+            buffers.Allocate(import->format, vertexCount, indexBytes);
+            quantization = import->quantization;
+            meshes.reserve(import->meshes.size());
+        });
+        for (size_t i = 0; i < import->meshes.size(); i++)
+            uploads.Push([this, import, i]() { uploadMesh(*import, i); });
+        uploads.Push([this, path, import, start]()
+        {
+            buildBatches();
+            computeBounds();
+            resident = true;
+            // from LoadAsync until the model can be drawn, waiting on the pool and the upload budget included
+            StartupProfiler::Instance().Record("model load", path, start, chrono::steady_clock::now());
+            size_t residentBefore = ResidentSetBytes();
+            size_t meshBytes = releaseImport(*import);
+            reportLoad(path, *import, start);
+            reportMemory(path, meshBytes, residentBefore, ResidentSetBytes());
+            reportDraws(path, *import);
+        });
+    }
+
+    // creates the GL objects of one processed mesh. Must run on the GL thread.
+    void uploadMesh(ModelImport &import, size_t index)
+    {
+        StartupTimer timer("model", "upload mesh " + to_string(index) + " of " + path);
+        const MeshView &mesh = import.meshes[index];
+        vector<Texture> textures;
+        textures.reserve(mesh.textures.size());
+        for (const Texture &texture : mesh.textures)
+            textures.push_back(loadTexture(texture.path, texture.type));
+        const void *packedVertices = import.packedVertices.empty() ? (const void *)mesh.vertices : import.packedVertices[index].data();
+        bool shortIndices = !import.packedIndices[index].empty();
+        const void *packedIndices = shortIndices ? (const void *)import.packedIndices[index].data() : (const void *)mesh.indices;
+        meshes.emplace_back(buffers, mesh, packedVertices, packedIndices, shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                            std::move(textures), keepMeshData && import.warm);
+        if (keepMeshData && !import.warm)
+        {
+            // a fresh import owns its data, it is moved into the mesh instead of copied
+            meshes.back().vertices = std::move(import.imported[index].vertices);
+            meshes.back().indices = std::move(import.imported[index].indices);
+        }
+        meshes.back().SetShaderTextureNamePrefix(glslIdentifierPrefix);
+    }
+
+    void buildBatches()
+    {
+        batches.clear();
+        drawBaseVertices.clear();
+        // meshes with fewer levels than others draw their coarsest one in the levels they lack
+        size_t levels = 0;
+        for (const Mesh &mesh : meshes)
+            levels = max(levels, mesh.lods.size());
+        lodErrors.assign(levels, 0.0f);
+        drawCounts.assign(levels, vector<GLsizei>());
+        drawOffsets.assign(levels, vector<const void *>());
+        lod = 0;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            for (size_t level = 0; level < levels; level++)
+            {
+                size_t own = min(level, meshes[i].lods.size() - 1);
+                lodErrors[level] = max(lodErrors[level], meshes[i].lods[own].error);
+                drawCounts[level].push_back((GLsizei)meshes[i].lods[own].indexCount);
+                drawOffsets[level].push_back((const void *)meshes[i].lodIndexOffsets[own]);
+            }
+            drawBaseVertices.push_back(meshes[i].baseVertex);
+            const Mesh &batchStart = meshes[batches.empty() ? 0 : batches.back().first];
+            if (!batches.empty() && meshes[i].indexType == batchStart.indexType && meshes[i].SameTextures(batchStart))
+                batches.back().count++;
+            else
+                batches.push_back(MeshBatch{i, 1});
+        }
+    }
+
+    // extends the last range if it continues, else starts a new one
+    void addVisibleRange(GLsizei count, const void *offset, GLint baseVertex, bool continues)
+    {
+        if (continues)
+        {
+            visibleCounts.back() += count;
+            return;
+        }
+        visibleCounts.push_back(count);
+        visibleOffsets.push_back(offset);
+        visibleBaseVertices.push_back(baseVertex);
+    }
+
+    // Draw after a Cull
+    void drawVisible(Shader &shader)
+    {
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            const MeshBatch &visible = visibleBatches[b];
+            if (visible.count == 0)
+                continue;
+            const Mesh &first = meshes[batches[b].first];
+            meshes[batches[b].first].BindTextures(shader);
+            if (visible.count == 1)
+                glDrawElementsBaseVertex(GL_TRIANGLES, visibleCounts[visible.first], first.indexType, visibleOffsets[visible.first],
+                                         visibleBaseVertices[visible.first]);
+            else
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, &visibleCounts[visible.first], first.indexType, &visibleOffsets[visible.first],
+                                              (GLsizei)visible.count, &visibleBaseVertices[visible.first]);
+        }
+        culled = false;
+    }
+
+    // box around the mesh boxes for culling, sphere around the mesh spheres for picking the detail level
+    void computeBounds()
+    {
+        if (meshes.empty())
+            return;
+        boundsMin = meshes[0].boundsMin;
+        boundsMax = meshes[0].boundsMax;
+        glm::vec3 minimum = meshes[0].boundsCenter, maximum = meshes[0].boundsCenter;
+        for (const Mesh &mesh : meshes)
+        {
+            boundsMin = glm::min(boundsMin, mesh.boundsMin);
+            boundsMax = glm::max(boundsMax, mesh.boundsMax);
+            minimum = glm::min(minimum, mesh.boundsCenter - glm::vec3(mesh.boundsRadius));
+            maximum = glm::max(maximum, mesh.boundsCenter + glm::vec3(mesh.boundsRadius));
+        }
+        boundsCenter = (minimum + maximum) * 0.5f;
+        boundsRadius = 0.0f;
+        for (const Mesh &mesh : meshes)
+            boundsRadius = max(boundsRadius, glm::length(mesh.boundsCenter - boundsCenter) + mesh.boundsRadius);
+    }
+
+    // frees the imported meshes, or unmaps the cache file, once everything is uploaded. Returns the size of the
+    // processed mesh data.
+    static size_t releaseImport(ModelImport &import)
+    {
+        size_t bytes = 0;
+        for (const MeshView &mesh : import.meshes)
+            bytes += mesh.vertexCount * sizeof(Vertex) + mesh.indexCount * sizeof(unsigned int);
+        import.meshes.clear();
+        vector<vector<unsigned char>>().swap(import.packedVertices);
+        vector<vector<uint16_t>>().swap(import.packedIndices);
+        vector<MeshData>().swap(import.imported);
+        import.cache.Close();
+        return bytes;
+    }
+
+    void reportMemory(string const &path, size_t meshBytes, size_t residentBefore, size_t residentAfter) const
+    {
+        double megabyte = 1024.0 * 1024.0;
+        cout << "MODEL::VERTICES " << path << " " << buffers.format.stride << " bytes per vertex (" << buffers.format.Describe()
+             << "), " << buffers.vertexCount * buffers.format.stride / megabyte << " MB instead of "
+             << buffers.vertexCount * sizeof(Vertex) / megabyte << " MB" << endl;
+        size_t shortMeshes = 0;
+        for (const Mesh &mesh : meshes)
+            shortMeshes += mesh.indexType == GL_UNSIGNED_SHORT;
+        cout << "MODEL::LOD " << path << " " << lodErrors.size() << " levels:";
+        for (size_t level = 0; level < lodErrors.size(); level++)
+        {
+            size_t triangles = 0;
+            for (GLsizei count : drawCounts[level])
+                triangles += count / 3;
+            cout << " " << triangles << " triangles (error " << lodErrors[level] << ")";
+        }
+        cout << endl;
+        cout << "MODEL::INDICES " << path << " " << shortMeshes << " of " << meshes.size() << " meshes with 16 bit indices, "
+             << buffers.indexBytes / megabyte << " MB" << endl;
+        cout << "MODEL::MEMORY " << path << " " << meshBytes / megabyte << " MB of mesh data "
+             << (keepMeshData ? "kept on the CPU" : "dropped after upload") << ", resident set "
+             << residentBefore / megabyte << " -> " << residentAfter / megabyte << " MB" << endl;
+    }
+
+    // one draw per mesh the file has, as without merging and batching, against the draws of a frame now
+    void reportDraws(string const &path, const ModelImport &import) const
+    {
+        cout << "MODEL::DRAWS " << path << " " << import.sourceMeshes << " meshes in the file, " << meshes.size()
+             << " after merging by material, " << batches.size() << " draw calls instead of " << import.sourceMeshes << endl;
+    }
+
+    static void reportLoad(string const &path, const ModelImport &import, chrono::steady_clock::time_point start)
+    {
+        cout << "MODEL::LOAD " << path << (import.warm ? " warm " : " cold ") << millisecondsSince(start) << " ms"
+             << " (import " << import.importMs << " ms";
+        if (import.warm)
+            cout << ", cold " << import.coldMs << " ms";
+        cout << ")" << endl;
+        if (!import.textures.empty())
+        {
+            double summedMs = 0.0;
+            for (double ms : import.decodeMs)
+                summedMs += ms;
+            cout << "MODEL::TEXTURES " << path << " " << import.textures.size() << " decoded in " << import.decodeWallMs
+                 << " ms (" << summedMs << " ms summed over threads)" << endl;
+        }
+    }
+
+    static double millisecondsSince(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // Meshes are transformed into model space by the transforms of their node and its parents, and appended to the
+    // mesh of the same material and vertex layout seen before, so a material costs one set of texture binds and
+    // one draw however many pieces the file splits it into.
+    static void processNode(aiNode *node, const aiScene *scene, const glm::mat4 &parentTransform, vector<MeshData> &meshes,
+                            vector<uint64_t> &mergeKeys, unordered_map<uint64_t, size_t> &merging, uint32_t &sourceMeshes)
     {
+        // assimp matrices are row major, glm ones column major
+        const aiMatrix4x4 &m = node->mTransformation;
+        glm::mat4 local;
+        local[0] = glm::vec4(m.a1, m.b1, m.c1, m.d1);
+        local[1] = glm::vec4(m.a2, m.b2, m.c2, m.d2);
+        local[2] = glm::vec4(m.a3, m.b3, m.c3, m.d3);
+        local[3] = glm::vec4(m.a4, m.b4, m.c4, m.d4);
+        glm::mat4 transform = parentTransform * local;
+
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            uint64_t key = (uint64_t)mesh->mMaterialIndex << 2 | (uint64_t)mesh->HasNormals() << 1 | (mesh->mTextureCoords[0] != nullptr);
+            auto target = merging.find(key);
+            if (target == merging.end() || meshes[target->second].vertices.size() + mesh->mNumVertices > MODEL_MERGE_MAX_VERTICES)
+            {
+                merging[key] = meshes.size();
+                meshes.emplace_back();
+                meshes.back().textures = processMaterial(scene->mMaterials[mesh->mMaterialIndex]);
+                mergeKeys.push_back(key);
+            }
+            appendMesh(mesh, transform, meshes[merging[key]]);
+            sourceMeshes++;
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, transform, meshes, mergeKeys, merging, sourceMeshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // puts the meshes a material was split into next to each other, so they are batched into one draw
+    static void sortByMaterial(vector<MeshData> &meshes, const vector<uint64_t> &mergeKeys)
+    {
+        unordered_map<uint64_t, size_t> firstSeen;
+        vector<size_t> order(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            firstSeen.emplace(mergeKeys[i], i);
+            order[i] = i;
+        }
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return firstSeen[mergeKeys[a]] < firstSeen[mergeKeys[b]]; });
+        vector<MeshData> sorted;
+        sorted.reserve(meshes.size());
+        for (size_t i : order)
+            sorted.push_back(std::move(meshes[i]));
+        meshes.swap(sorted);
+    }
+
+    // appends the vertices and faces of a mesh, transformed into model space, to data
+    static void appendMesh(aiMesh *mesh, const glm::mat4 &transform, MeshData &data)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        unsigned int first = (unsigned int)vertices.size();
+        // the vertices are written in place, Triangulate leaves three indices per face
+        vertices.resize(first + mesh->mNumVertices);
+        indices.reserve(indices.size() + mesh->mNumFaces * 3);
+        // normals need the inverse transpose to stay perpendicular under non-uniform scales, tangents follow the surface
+        glm::mat3 linear(transform);
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+        auto direction = [](const glm::mat3 &matrix, const aiVector3D &v)
+        {
+            glm::vec3 transformed = matrix * glm::vec3(v.x, v.y, v.z);
+            float length = glm::length(transformed);
+            return length > 0.0f ? transformed / length : transformed;
+        };
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+            Vertex &vertex = vertices[first + i];
             // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
+            vertex.Position = glm::vec3(transform * glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f));
             // normals
             if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
+                vertex.Normal = direction(normalMatrix, mesh->mNormals[i]);
             // texture coordinates
             if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
             {
@@ -125,34 +933,32 @@ private:
                 vec.x = mesh->mTextureCoords[0][i].x;
                 vec.y = mesh->mTextureCoords[0][i].y;
                 vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
-
-
+            // tangent and bitangent, only imported for shaders that read them
+            if (mesh->HasTangentsAndBitangents())
+            {
+                vertex.Tangent = direction(linear, mesh->mTangents[i]);
+                vertex.Bitangent = direction(linear, mesh->mBitangents[i]);
+            }
         }
+        // a mirroring transform turns the triangles inside out, their winding is flipped back
+        bool mirrored = glm::determinant(linear) < 0.0f;
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+                indices.push_back(first + face.mIndices[mirrored ? (face.mNumIndices - j) % face.mNumIndices : j]);
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    }
+
+    // collects the textures of a material
+    static vector<Texture> processMaterial(aiMaterial *material)
+    {
+        vector<Texture> textures;
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
         // Same applies to other texture as the following list summarizes:
@@ -164,56 +970,69 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, TEXTURE_DIFFUSE);
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, TEXTURE_SPECULAR);
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, TEXTURE_NORMAL);
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, TEXTURE_HEIGHT);
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // only type and path are known yet, GL objects are created when the mesh is uploaded
+        return textures;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects all material textures of a given type. Only type and path are filled in, the textures
+    // themselves are loaded when the mesh is uploaded.
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, TextureType textureType)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = textureType;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
+
+    // returns the texture with the given path relative to the model directory, loading it only if it wasn't loaded before.
+    Texture loadTexture(string const &path, TextureType type)
+    {
+        // check if texture was loaded before and if so, skip loading a new texture
+        auto loaded = loadedIndex.find(path);
+        if (loaded != loadedIndex.end())
+        {
+            // a texture with the same filepath has already been loaded, continue to next one. (optimization)
+            Texture texture = textures_loaded[loaded->second];
+            texture.type = type;    // another material may use the same file for something else
+            return texture;
+        }
+        // if texture hasn't been loaded already, load it
+        Texture texture;
+        texture.id = TextureFromFile(path.c_str(), this->directory);
+        texture.type = type;
+        texture.path = path;
+        addLoadedTexture(texture);
+        return texture;
+    }
+
+    // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    void addLoadedTexture(const Texture &texture)
+    {
+        loadedIndex[texture.path] = textures_loaded.size();
+        textures_loaded.push_back(texture);
+    }
 };
 
 
@@ -221,39 +1040,8 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 {
     string filename = string(path);
     filename = directory + '/' + filename;
+    StartupTimer timer("texture file", filename);
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureManager::Instance().Load2D(filename, gamma);
 }
 #endif
@@ -0,0 +1,20 @@
+#ifndef PROCESS_MEMORY_H
+#define PROCESS_MEMORY_H
+
+#include <cstddef>
+#include <fstream>
+
+#include <unistd.h>
+
+// resident set size of this process in bytes, read from /proc/self/statm. 0 where that isn't available.
+size_t ResidentSetBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    if (!(statm >> totalPages >> residentPages))
+        return 0;
+    return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+#endif
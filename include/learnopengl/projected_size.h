@@ -0,0 +1,21 @@
+#ifndef PROJECTED_SIZE_H
+#define PROJECTED_SIZE_H
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+// on-screen diameter in pixels of a world space bounding sphere for a perspective projection, 0 if it is behind
+// the camera. Spheres around the camera count as filling the screen.
+float ProjectedSphereSize(const glm::vec3 &center, float radius, const glm::mat4 &view, const glm::mat4 &projection,
+                          float viewportHeight)
+{
+    float depth = -glm::vec3(view * glm::vec4(center, 1.0f)).z;
+    if (depth < -radius)
+        return 0.0f;
+    if (depth <= radius)
+        return std::numeric_limits<float>::infinity();
+    return radius / depth * projection[1][1] * viewportHeight;
+}
+
+#endif
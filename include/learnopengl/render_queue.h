@@ -0,0 +1,253 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/billboard_batch.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/indirect_draws.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// passes run in this order. Within a pass draws are grouped by program, then material, then VAO, and go front to
+// back, except in RENDER_PASS_TRANSPARENT, where blending needs them back to front before anything else.
+enum RenderPass : uint64_t {
+    RENDER_PASS_OPAQUE = 0,
+    RENDER_PASS_ALPHA_TESTED = 1,   // discarding shaders, after the opaque ones so those keep early depth testing
+    RENDER_PASS_SKY = 2,            // at the far plane, only fills what nothing else covered
+    RENDER_PASS_TRANSPARENT = 3,
+};
+
+// fixed function state a draw needs, set back to the defaults after the queue ran
+struct RenderState {
+    GLenum depthFunc = GL_LESS;
+    bool cullFrontFaces = false;
+};
+
+// the kinds of draws the scene submits
+enum DrawKind {
+    DRAW_MODEL,             // object->Draw with model as the "model" uniform
+    DRAW_MODEL_INDIRECT,    // the commands object added to indirect
+    DRAW_BILLBOARDS,        // every instance of billboards
+    DRAW_FLOAT_TRIANGLES,   // vertexCount unquantized vertices in a model shader, with model as the "model" uniform
+    DRAW_TRIANGLES          // vertexCount vertices without per object uniforms
+};
+
+// what a packet draws once the queue bound its program, VAO and texture. Plain data, so submitting a draw doesn't
+// allocate.
+struct DrawCall {
+    DrawKind kind;
+    glm::mat4 model;
+    Model *object = nullptr;
+    IndirectDraws *indirect = nullptr;
+    BillboardBatch *billboards = nullptr;
+    GLsizei vertexCount = 0;
+
+    static DrawCall OfModel(Model &object, const glm::mat4 &model)
+    {
+        DrawCall draw(DRAW_MODEL);
+        draw.object = &object;
+        draw.model = model;
+        return draw;
+    }
+
+    static DrawCall OfIndirect(Model &object, IndirectDraws &indirect)
+    {
+        DrawCall draw(DRAW_MODEL_INDIRECT);
+        draw.object = &object;
+        draw.indirect = &indirect;
+        return draw;
+    }
+
+    static DrawCall OfBillboards(BillboardBatch &billboards)
+    {
+        DrawCall draw(DRAW_BILLBOARDS);
+        draw.billboards = &billboards;
+        return draw;
+    }
+
+    static DrawCall OfFloatTriangles(GLsizei vertexCount, const glm::mat4 &model)
+    {
+        DrawCall draw(DRAW_FLOAT_TRIANGLES);
+        draw.vertexCount = vertexCount;
+        draw.model = model;
+        return draw;
+    }
+
+    static DrawCall OfTriangles(GLsizei vertexCount)
+    {
+        DrawCall draw(DRAW_TRIANGLES);
+        draw.vertexCount = vertexCount;
+        return draw;
+    }
+
+    // sets the per object uniforms and draws
+    void Run(Shader &shader) const
+    {
+        switch (kind)
+        {
+        case DRAW_MODEL:
+            shader.setMat4("model", model);
+            object->Draw(shader);
+            break;
+        case DRAW_MODEL_INDIRECT:
+            object->DrawIndirect(*indirect, shader);
+            break;
+        case DRAW_BILLBOARDS:
+            billboards->Draw();
+            break;
+        case DRAW_FLOAT_TRIANGLES:
+            // model shaders dequantize positions, with the box of whichever model they drew last
+            shader.setMat4("model", model);
+            shader.setVec3("positionScale", glm::vec3(1.0f));
+            shader.setVec3("positionOffset", glm::vec3(0.0f));
+            glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+            break;
+        case DRAW_TRIANGLES:
+            glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+            break;
+        }
+    }
+
+private:
+    explicit DrawCall(DrawKind kind) : kind(kind) {}
+};
+
+// one draw submitted to the RenderQueue
+struct DrawPacket {
+    uint64_t key;
+    Shader *shader;
+    unsigned int vao;           // bound by the queue, 0 if draw binds its own
+    GLenum textureTarget;
+    unsigned int texture;       // bound to unit 0 by the queue, 0 if draw binds its own
+    RenderState state;
+    DrawCall draw;
+};
+
+// Collects the draws of a frame and executes them sorted by a 64 bit key, so programs, textures and VAOs only change
+// where the sorted order changes them, however the scene submits its objects. Binds go through GLState, which skips
+// the ones that are already in place.
+//
+// key, from the most significant bit: pass (4 bits), then
+//   depth (24 bits), program (8), material (16), VAO (12)    in RENDER_PASS_TRANSPARENT, depth back to front
+//   program (8), material (16), VAO (12), depth (24)         in all other passes, depth front to back
+// Programs, materials (the texture of a packet) and VAOs are numbered densely in the order the queue first sees them.
+class RenderQueue
+{
+public:
+    // starts collecting the draws of a frame. Depths are measured from the camera and clamped to farPlane.
+    void BeginFrame(float farPlane)
+    {
+        packets.clear();
+        this->farPlane = farPlane;
+    }
+
+    void Submit(RenderPass pass, Shader &shader, unsigned int vao, GLenum textureTarget, unsigned int texture, float depth,
+                const RenderState &state, const DrawCall &draw)
+    {
+        uint64_t program = ordinal(programs, shader.ID, 8);
+        uint64_t material = ordinal(materials, texture, 16);
+        uint64_t array = ordinal(arrays, vao, 12);
+        uint64_t quantized = (uint64_t)(glm::clamp(depth / farPlane, 0.0f, 1.0f) * 0xffffff);
+        uint64_t key = (uint64_t)pass << 60;
+        if (pass == RENDER_PASS_TRANSPARENT)
+            key |= (0xffffff - quantized) << 36 | program << 28 | material << 12 | array;
+        else
+            key |= program << 52 | material << 36 | array << 24 | quantized;
+        packets.push_back(DrawPacket{key, &shader, vao, textureTarget, texture, state, draw});
+    }
+
+    // distance of a world space point in front of the camera
+    static float ViewDepth(const glm::mat4 &view, const glm::vec3 &position)
+    {
+        return -(view * glm::vec4(position, 1.0f)).z;
+    }
+
+    // executes the frame's draws in key order
+    void Execute()
+    {
+        stats.frames++;
+        stats.packets += packets.size();
+        stats.submittedProgramChanges += programChanges();
+        stable_sort(packets.begin(), packets.end(), [](const DrawPacket &a, const DrawPacket &b) { return a.key < b.key; });
+
+        GLState &gl = GLState::Instance();
+        unsigned int program = 0;
+        for (DrawPacket &packet : packets)
+        {
+            if (packet.shader->ID != program)
+            {
+                packet.shader->use();
+                program = packet.shader->ID;
+                stats.programBinds++;
+            }
+            if (packet.vao != 0)
+                gl.BindVertexArray(packet.vao);
+            if (packet.texture != 0)
+                gl.BindTexture(0, packet.textureTarget, packet.texture);
+            apply(packet.state);
+            packet.draw.Run(*packet.shader);
+        }
+        apply(RenderState());
+        packets.clear();
+    }
+
+    void PrintStats() const
+    {
+        double frames = stats.frames > 0 ? (double)stats.frames : 1.0;
+        cout << "RENDER::QUEUE " << stats.frames << " frames, per frame " << stats.packets / frames << " draws, "
+             << stats.programBinds / frames << " program binds (" << stats.submittedProgramChanges / frames
+             << " in submission order)" << endl;
+    }
+
+private:
+    struct Stats {
+        size_t frames = 0;
+        size_t packets = 0;
+        size_t programBinds = 0;
+        size_t submittedProgramChanges = 0;
+    };
+
+    vector<DrawPacket> packets;
+    unordered_map<unsigned int, uint64_t> programs;
+    unordered_map<unsigned int, uint64_t> materials;
+    unordered_map<unsigned int, uint64_t> arrays;
+    float farPlane = 100.0f;
+    Stats stats;
+
+    // dense number of a GL name, wrapping around once bits run out (which only costs sorting quality)
+    static uint64_t ordinal(unordered_map<unsigned int, uint64_t> &ordinals, unsigned int name, int bits)
+    {
+        auto found = ordinals.emplace(name, (uint64_t)ordinals.size());
+        return found.first->second & (((uint64_t)1 << bits) - 1);
+    }
+
+    // program binds the frame would have taken in the order it was submitted
+    size_t programChanges() const
+    {
+        size_t changes = 0;
+        for (size_t i = 0; i < packets.size(); i++)
+            changes += i == 0 || packets[i].shader->ID != packets[i - 1].shader->ID;
+        return changes;
+    }
+
+    static void apply(const RenderState &state)
+    {
+        GLState &gl = GLState::Instance();
+        gl.DepthFunc(state.depthFunc);
+        gl.Enable(GL_CULL_FACE, state.cullFrontFaces);
+        if (state.cullFrontFaces)
+            gl.CullFace(GL_FRONT);
+    }
+};
+
+#endif
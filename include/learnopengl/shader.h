@@ -4,11 +4,48 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/asset_archive.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/startup_profiler.h>
+#include <learnopengl/uniform_blocks.h>
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstdint>
+#include <unordered_map>
 #include <common.h>
+
+// name of a uniform, looked up by its 64 bit FNV-1a hash. For string literals the hash is constexpr, so an optimizing
+// compiler works it out at compile time and setting a uniform by a literal name touches no strings at all.
+struct UniformName
+{
+    uint64_t hash;
+
+    template <size_t N>
+    constexpr UniformName(const char (&name)[N]) : hash(Hash(name, N - 1))
+    {
+    }
+    UniformName(const std::string &name) : hash(Hash(name.c_str(), name.size()))
+    {
+    }
+
+    static constexpr uint64_t Hash(const char *name, size_t length)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ (unsigned char)name[i]) * 1099511628211ull;
+        return hash;
+    }
+};
+
+// a uniform location resolved once with Shader::locate, for uniforms set often enough that even the hash lookup shows
+struct UniformLocation
+{
+    GLint location = -1;    // -1 if the program has no such active uniform, setting it is then a no-op
+};
+
 class Shader
 {
 public:
@@ -22,48 +59,15 @@ public:
 
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
+        // reading, compiling and linking is one startup phase, the driver may defer compiling until the status checks
+        StartupTimer timer("shader", vertexPathString + " + " + fragmentPathString);
+        // 1. retrieve the vertex/fragment source code from filePath, out of the asset archive if there is one
+        std::string vertexCode = readSource(vertexPath);
+        std::string fragmentCode = readSource(fragmentPath);
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
+        // if geometry shader path is present, also load a geometry shader
+        if(geometryPath != nullptr)
+            geometryCode = readSource(geometryPath);
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -101,74 +105,198 @@ public:
         glDeleteShader(fragment);
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
-
+        introspectUniforms();
+        bindUniformBlocks();
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::Instance().UseProgram(ID);
     }
-    // utility uniform functions
+    // location of an active uniform, found in the table filled at link time
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    UniformLocation locate(UniformName name) const
+    {
+        UniformLocation uniform;
+        uniform.location = location(name);
+        return uniform;
+    }
+    // utility uniform functions, by name or by a location from locate
+    // ------------------------------------------------------------------------
+    void setBool(UniformName name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
+    }
+    void setBool(UniformLocation uniform, bool value) const
+    {
+        glUniform1i(uniform.location, (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(UniformName name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
+    }
+    void setInt(UniformLocation uniform, int value) const
+    {
+        glUniform1i(uniform.location, value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(UniformName name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
+    }
+    void setFloat(UniformLocation uniform, float value) const
+    {
+        glUniform1f(uniform.location, value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(UniformName name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(UniformName name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
+    }
+    void setVec2(UniformLocation uniform, const glm::vec2 &value) const
+    {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    }
+    void setVec2(UniformLocation uniform, float x, float y) const
+    {
+        glUniform2f(uniform.location, x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(UniformName name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(UniformName name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
+    }
+    void setVec3(UniformLocation uniform, const glm::vec3 &value) const
+    {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void setVec3(UniformLocation uniform, float x, float y, float z) const
+    {
+        glUniform3f(uniform.location, x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(UniformName name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(UniformName name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
+    }
+    void setVec4(UniformLocation uniform, const glm::vec4 &value) const
+    {
+        glUniform4fv(uniform.location, 1, &value[0]);
+    }
+    void setVec4(UniformLocation uniform, float x, float y, float z, float w) const
+    {
+        glUniform4f(uniform.location, x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(UniformName name, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat2(UniformLocation uniform, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(UniformName name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(UniformLocation uniform, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(UniformName name, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformLocation uniform, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<uint64_t, GLint> uniformLocations;   // by UniformName hash, with [0] and without for arrays
+
+    GLint location(UniformName name) const
+    {
+        auto found = uniformLocations.find(name.hash);
+        return found != uniformLocations.end() ? found->second : -1;
+    }
+    // fills uniformLocations with every active uniform of the linked program, arrays with each of their elements
+    void introspectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+            std::string active = name.substr(0, length);
+            GLint first = glGetUniformLocation(ID, active.c_str());
+            if (first < 0)
+                continue;   // in a uniform block
+            addUniform(active, first);
+            if (size > 1 || (active.size() > 3 && active.compare(active.size() - 3, 3, "[0]") == 0))
+            {
+                // arrays are reported as name[0], the elements after it may have any location
+                std::string base = active.substr(0, active.rfind('['));
+                addUniform(base, first);
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()));
+                }
+            }
+        }
+    }
+    // attaches the shared uniform blocks the program declares (FrameData, LightData, ...) to their binding points
+    void bindUniformBlocks()
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            glGetActiveUniformBlockName(ID, (GLuint)i, sizeof(name), NULL, name);
+            GLuint binding;
+            if (UniformBlockBindingOf(name, binding))
+                glUniformBlockBinding(ID, (GLuint)i, binding);
+            else
+                std::cout << "ERROR::SHADER::UNKNOWN_UNIFORM_BLOCK " << name << std::endl;
+        }
+    }
+    void addUniform(const std::string &name, GLint location)
+    {
+        auto added = uniformLocations.emplace(UniformName(name).hash, location);
+        if (!added.second && added.first->second != location)
+            std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION " << name << std::endl;
+    }
+    static std::string readSource(const char *path)
+    {
+        AssetBytes bytes = AssetArchive::Instance().Read(path);
+        if (!bytes.found)
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        return std::string((const char *)bytes.data, bytes.size);
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
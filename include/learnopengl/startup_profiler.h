@@ -0,0 +1,205 @@
+#ifndef STARTUP_PROFILER_H
+#define STARTUP_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// where Finish writes the startup timings, relative to the working directory
+const char *const STARTUP_TIMING_FILE = "startup_timing.json";
+
+// one timed part of startup. Phases of loader threads overlap with each other and with the main thread.
+// Phases may nest, a "texture file" load contains the "texture" decode and upload, so they go by another category.
+struct StartupPhase {
+    string category;        // "window", "shader", "model", "texture", ...
+    string name;
+    double startMs;         // since startup
+    double durationMs;
+    unsigned int thread;    // 0 for the thread that started the profiler, other threads count up as they show up
+};
+
+// Collects the phases of startup from any thread, up to Finish, which prints them longest first and writes them
+// to a JSON file, so startup can be compared across code and asset changes. Phases ending after Finish are not
+// part of startup and are dropped.
+class StartupProfiler
+{
+public:
+    // startup begins with the first call, which should be the first thing main does
+    static StartupProfiler &Instance()
+    {
+        static StartupProfiler profiler;
+        return profiler;
+    }
+
+    void Record(const string &category, const string &name, chrono::steady_clock::time_point start,
+                chrono::steady_clock::time_point end)
+    {
+        if (finished)
+            return;
+        lock_guard<mutex> lock(phasesMutex);
+        phases.push_back(StartupPhase{category, name, millisecondsBetween(origin, start), millisecondsBetween(start, end),
+                                      threadIndex()});
+    }
+
+    // a point in time startup reached, like the first frame being shown
+    void Milestone(const string &name)
+    {
+        if (finished)
+            return;
+        lock_guard<mutex> lock(phasesMutex);
+        milestones.emplace_back(name, millisecondsBetween(origin, chrono::steady_clock::now()));
+    }
+
+    bool Finished() const { return finished; }
+
+    // ends startup, prints the phases longest first with the time per category and writes them to path
+    bool Finish(const string &path = STARTUP_TIMING_FILE)
+    {
+        lock_guard<mutex> lock(phasesMutex);
+        if (finished.exchange(true))
+            return false;
+        double totalMs = millisecondsBetween(origin, chrono::steady_clock::now());
+        stable_sort(phases.begin(), phases.end(),
+                    [](const StartupPhase &a, const StartupPhase &b) { return a.durationMs > b.durationMs; });
+        // per category: summed duration, number of phases
+        map<string, pair<double, size_t>> categories;
+        for (const StartupPhase &phase : phases)
+        {
+            categories[phase.category].first += phase.durationMs;
+            categories[phase.category].second++;
+        }
+
+        cout << "STARTUP:: " << totalMs << " ms, " << phases.size() << " phases on " << threads.size() << " threads" << endl;
+        for (const pair<string, double> &milestone : milestones)
+            cout << "STARTUP::MILESTONE " << milestone.first << " at " << milestone.second << " ms" << endl;
+        for (const auto &category : categories)
+            cout << "STARTUP::CATEGORY " << category.first << " " << category.second.first << " ms summed over "
+                 << category.second.second << " phases" << endl;
+        for (const StartupPhase &phase : phases)
+        {
+            char line[64];
+            snprintf(line, sizeof(line), "%10.2f ms at %10.2f ms, thread %u", phase.durationMs, phase.startMs, phase.thread);
+            cout << "STARTUP::PHASE " << line << " " << phase.category << ": " << phase.name << endl;
+        }
+
+        ofstream out(path, ios::trunc);
+        out << "{\n  \"totalMs\": " << totalMs << ",\n  \"threads\": " << threads.size() << ",\n  \"milestones\": [";
+        for (size_t i = 0; i < milestones.size(); i++)
+            out << (i ? "," : "") << "\n    {\"name\": " << quoted(milestones[i].first) << ", \"ms\": " << milestones[i].second << "}";
+        out << "\n  ],\n  \"categories\": [";
+        size_t written = 0;
+        for (const auto &category : categories)
+            out << (written++ ? "," : "") << "\n    {\"category\": " << quoted(category.first) << ", \"durationMs\": "
+                << category.second.first << ", \"phases\": " << category.second.second << "}";
+        out << "\n  ],\n  \"phases\": [";
+        for (size_t i = 0; i < phases.size(); i++)
+            out << (i ? "," : "") << "\n    {\"category\": " << quoted(phases[i].category) << ", \"name\": "
+                << quoted(phases[i].name) << ", \"startMs\": " << phases[i].startMs << ", \"durationMs\": "
+                << phases[i].durationMs << ", \"thread\": " << phases[i].thread << "}";
+        out << "\n  ]\n}\n";
+        out.close();
+        if (!out)
+        {
+            cout << "ERROR::STARTUP_PROFILER:: could not write " << path << endl;
+            return false;
+        }
+        cout << "STARTUP:: timings written to " << path << endl;
+        return true;
+    }
+
+private:
+    chrono::steady_clock::time_point origin;
+    mutex phasesMutex;
+    vector<StartupPhase> phases;
+    vector<pair<string, double>> milestones;
+    vector<thread::id> threads;
+    atomic<bool> finished{false};
+
+    StartupProfiler() : origin(chrono::steady_clock::now())
+    {
+        threads.push_back(this_thread::get_id());
+    }
+
+    static double millisecondsBetween(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end)
+    {
+        return chrono::duration<double, milli>(end - start).count();
+    }
+
+    // called with phasesMutex held
+    unsigned int threadIndex()
+    {
+        thread::id id = this_thread::get_id();
+        auto found = find(threads.begin(), threads.end(), id);
+        if (found != threads.end())
+            return (unsigned int)(found - threads.begin());
+        threads.push_back(id);
+        return (unsigned int)threads.size() - 1;
+    }
+
+    // JSON string literal
+    static string quoted(const string &text)
+    {
+        string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+                out += escaped;
+            }
+            else
+                out += c;
+        }
+        return out + "\"";
+    }
+};
+
+// times the scope it lives in as one startup phase, or up to Stop
+class StartupTimer
+{
+public:
+    StartupTimer(string category, string name)
+        : category(std::move(category)), name(std::move(name)), start(chrono::steady_clock::now())
+    {
+    }
+
+    ~StartupTimer()
+    {
+        Stop();
+    }
+
+    void Stop()
+    {
+        if (stopped)
+            return;
+        StartupProfiler::Instance().Record(category, name, start, chrono::steady_clock::now());
+        stopped = true;
+    }
+
+    StartupTimer(const StartupTimer &) = delete;
+    StartupTimer &operator=(const StartupTimer &) = delete;
+
+private:
+    string category;
+    string name;
+    chrono::steady_clock::time_point start;
+    bool stopped = false;
+};
+
+#endif
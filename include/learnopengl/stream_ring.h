@@ -0,0 +1,220 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// glad is generated for GL 3.3, buffer storage (GL 4.4 or ARB_buffer_storage) is declared and loaded here
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+// frames the CPU may be ahead of the GPU, each has a region of the ring of its own
+const unsigned int STREAM_RING_FRAMES = 3;
+
+// where a StreamRing allocation is: data to write it through, offset to bind it at in StreamRing::Buffer
+struct StreamAllocation {
+    void *data;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+// Ring buffer for the data a frame streams to the GPU (uniform blocks, indirect commands, per draw data).
+// It is split into STREAM_RING_FRAMES regions. A frame bump-allocates in its region, which a fence guards until the
+// GPU is done with the frame that used it last; BeginFrame only waits if the GPU is that far behind.
+//
+// With buffer storage the ring is mapped once, persistently and coherently, so an allocation is written straight
+// into GPU visible memory. Without it writes go to a CPU copy that Flush uploads with one glBufferSubData per frame,
+// into a region no draw is reading thanks to the fences, so the driver doesn't have to synchronize either way.
+class StreamRing
+{
+public:
+    // loads glBufferStorage if the context has it, after glad. Returns whether the ring can be mapped persistently.
+    static bool Load(GLADloadproc load)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        bool available = major > 4 || (major == 4 && minor >= 4);
+        GLint extensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+        for (GLint i = 0; i < extensions && !available; i++)
+            available = strcmp((const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i), "GL_ARB_buffer_storage") == 0;
+        if (available)
+            bufferStorage() = (BufferStorageProc)load("glBufferStorage");
+        return Persistent();
+    }
+
+    static bool Persistent()
+    {
+        return bufferStorage() != nullptr;
+    }
+
+    // creates the ring with room for bytesPerFrame in every region. Must run on the GL thread, after Load.
+    void Create(size_t bytesPerFrame)
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = (size_t)alignment;
+        regionSize = align(bytesPerFrame, uniformAlignment);
+        size_t size = regionSize * STREAM_RING_FRAMES;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (Persistent())
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage()(GL_ARRAY_BUFFER, (GLsizeiptr)size, nullptr, flags);
+            mapped = (unsigned char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)size, flags);
+        }
+        if (!mapped)
+        {
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, nullptr, GL_STREAM_DRAW);
+            staging.resize(size);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // moves on to the next region, waiting for the GPU to finish the frame that used it before
+    void BeginFrame()
+    {
+        region = (region + 1) % STREAM_RING_FRAMES;
+        head = flushed = 0;
+        stats.frames++;
+        GLsync &fence = fences[region];
+        if (!fence)
+            return;
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            // the GPU is STREAM_RING_FRAMES frames behind, nothing to do but wait for it
+            auto start = chrono::steady_clock::now();
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                ;
+            stats.stalls++;
+            stats.stallMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    // size bytes at a multiple of alignment, in the current frame's region. If the region is full the data pointer
+    // is null and nothing may be written, the caller has to skip whatever it was for.
+    StreamAllocation Allocate(size_t size, size_t alignment)
+    {
+        size_t offset = align(head, alignment);
+        if (offset + size > regionSize)
+        {
+            if (stats.overflows++ == 0)
+                cout << "ERROR::STREAM_RING:: a frame needs more than " << regionSize << " bytes" << endl;
+            return StreamAllocation{nullptr, 0, 0};
+        }
+        head = offset + size;
+        stats.peakBytes = max(stats.peakBytes, head);
+        size_t start = region * regionSize + offset;
+        return StreamAllocation{(mapped ? mapped : staging.data()) + start, (GLintptr)start, (GLsizeiptr)size};
+    }
+
+    // copies value into a new allocation aligned for binding as a uniform block
+    template <typename T>
+    StreamAllocation Write(const T &value)
+    {
+        StreamAllocation allocation = Allocate(sizeof(T), uniformAlignment);
+        if (allocation.data)
+            memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+
+    // makes what was written since the last Flush visible to the GPU, before the draws reading it
+    void Flush()
+    {
+        if (!mapped && head > flushed)
+        {
+            size_t start = region * regionSize + flushed;
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)start, (GLsizeiptr)(head - flushed), staging.data() + start);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        flushed = head;
+    }
+
+    // after the frame's last draw reading the ring
+    void EndFrame()
+    {
+        Flush();
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    unsigned int Buffer() const { return buffer; }
+    size_t UniformAlignment() const { return uniformAlignment; }
+
+    void PrintStats() const
+    {
+        double frames = stats.frames > 0 ? (double)stats.frames : 1.0;
+        cout << "GL::STREAM_RING " << (mapped ? "persistent" : "staged") << ", " << STREAM_RING_FRAMES << " x " << regionSize
+             << " bytes, at most " << stats.peakBytes << " used by a frame, " << stats.stalls << " of " << stats.frames
+             << " frames stalled on the GPU (" << stats.stallMs / frames << " ms per frame), " << stats.overflows
+             << " allocations that didn't fit" << endl;
+    }
+
+    void Delete()
+    {
+        for (GLsync &fence : fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        if (mapped)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            mapped = nullptr;
+        }
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+private:
+    struct Stats {
+        size_t frames = 0;
+        size_t stalls = 0;      // frames BeginFrame had to wait for the GPU
+        double stallMs = 0.0;
+        size_t overflows = 0;
+        size_t peakBytes = 0;
+    };
+
+    unsigned int buffer = 0;
+    unsigned char *mapped = nullptr;    // the whole ring, with buffer storage
+    vector<unsigned char> staging;      // the whole ring, without
+    size_t regionSize = 0;
+    size_t uniformAlignment = 256;
+    unsigned int region = 0;
+    size_t head = 0;                    // in the current region
+    size_t flushed = 0;
+    GLsync fences[STREAM_RING_FRAMES] = {};
+    Stats stats;
+
+    static BufferStorageProc &bufferStorage()
+    {
+        static BufferStorageProc function = nullptr;
+        return function;
+    }
+
+    static size_t align(size_t offset, size_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+};
+
+#endif
@@ -0,0 +1,418 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// CPU block compression of textures into BC1 (DXT1, opaque RGB) and BC3 (DXT5, RGBA) with a precomputed mip
+// chain, stored as DDS files. Nothing in here needs a GL context, so textures can be baked on machines without
+// a GPU (see tools/texture_compressor.cpp); uploading lives in texture_loader.h.
+//
+// Baked textures are named after the FNV-1a hash of the source file contents, so they are found again no
+// matter under which path the image is referenced and go stale automatically when the image changes.
+const char *const TEXTURE_CACHE_DIRECTORY = "resources/cache";
+
+enum class BlockFormat {
+    BC1,
+    BC3
+};
+
+struct CompressedLevel {
+    int width;
+    int height;
+    const unsigned char *data;
+    size_t size;
+};
+
+uint64_t Fnv1a64(const unsigned char *bytes, size_t count, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+string CompressedTexturePath(uint64_t contentHash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)contentHash);
+    return string(TEXTURE_CACHE_DIRECTORY) + "/" + name + ".dds";
+}
+
+// a DDS file, either built in memory by Encode or memory-mapped by Load. levels point into the file bytes.
+class CompressedTexture
+{
+public:
+    BlockFormat format = BlockFormat::BC1;
+    int width = 0;
+    int height = 0;
+    vector<CompressedLevel> levels;
+    double sourceLoadMs = 0.0;  // decoding the source image took this long when the texture was baked
+
+    size_t CompressedBytes() const
+    {
+        size_t bytes = 0;
+        for (const CompressedLevel &level : levels)
+            bytes += level.size;
+        return bytes;
+    }
+
+    // what the same texture costs uncompressed with RGB8/RGBA8 and a full mip chain
+    size_t UncompressedBytes() const
+    {
+        return (size_t)width * height * (format == BlockFormat::BC1 ? 3 : 4) * 4 / 3;
+    }
+
+    const char *FormatName() const { return format == BlockFormat::BC1 ? "BC1" : "BC3"; }
+
+    bool Load(const string &path)
+    {
+        if (!mapping.Open(path))
+            return false;
+        return parse(mapping.Data(), mapping.Size());
+    }
+
+    bool Save(const string &path) const
+    {
+        // the same content can be baked by several loader threads, or the compressor tool, at once. Each writer
+        // gets its own temp file and the last rename wins with identical bytes.
+        static atomic<unsigned> saves(0);
+        mkdir(TEXTURE_CACHE_DIRECTORY, 0755);
+        string tempPath = path + "." + to_string(getpid()) + "." + to_string(saves++) + ".tmp";
+        ofstream out(tempPath, ios::binary | ios::trunc);
+        out.write((const char *)storage.data(), storage.size());
+        out.close();
+        if (!out || rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // builds the mip chain of an 8 bit image with 3 or 4 components and block compresses every level.
+    // Images with 4 components whose alpha is fully opaque are stored as BC1.
+    void Encode(const unsigned char *pixels, int imageWidth, int imageHeight, int components, double decodeMs)
+    {
+        vector<unsigned char> level((size_t)imageWidth * imageHeight * 4);
+        bool opaque = true;
+        for (size_t i = 0; i < (size_t)imageWidth * imageHeight; i++)
+        {
+            for (int c = 0; c < 3; c++)
+                level[i * 4 + c] = pixels[i * components + c];
+            level[i * 4 + 3] = components == 4 ? pixels[i * components + 3] : 255;
+            opaque = opaque && level[i * 4 + 3] == 255;
+        }
+
+        format = opaque ? BlockFormat::BC1 : BlockFormat::BC3;
+        width = imageWidth;
+        height = imageHeight;
+        sourceLoadMs = decodeMs;
+        int mipCount = 1;
+        while ((width >> (mipCount - 1)) > 1 || (height >> (mipCount - 1)) > 1)
+            mipCount++;
+
+        storage.assign(sizeof(DDSHeader), 0);
+        int levelWidth = width, levelHeight = height;
+        for (int mip = 0; mip < mipCount; mip++)
+        {
+            encodeLevel(level.data(), levelWidth, levelHeight, storage);
+            if (mip + 1 < mipCount)
+                level = downsample(level, levelWidth, levelHeight);
+            levelWidth = max(1, levelWidth / 2);
+            levelHeight = max(1, levelHeight / 2);
+        }
+        writeHeader(mipCount);
+        parse(storage.data(), storage.size());
+    }
+
+private:
+    // DDS_HEADER preceded by the "DDS " magic. dwReserved1 carries a marker and the source decode time.
+    struct DDSHeader {
+        uint32_t magic;
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        uint32_t pfSize;
+        uint32_t pfFlags;
+        uint32_t pfFourCC;
+        uint32_t pfRGBBitCount;
+        uint32_t pfMasks[4];
+        uint32_t caps[4];
+        uint32_t reserved2;
+    };
+
+    static uint32_t fourCC(const char *code)
+    {
+        return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+    }
+
+    vector<unsigned char> storage;
+    MappedFile mapping;
+
+    size_t blockBytes() const { return format == BlockFormat::BC1 ? 8 : 16; }
+
+    void writeHeader(int mipCount)
+    {
+        DDSHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = fourCC("DDS ");
+        header.size = 124;
+        header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;   // caps, height, width, pixel format, mip count, linear size
+        header.height = (uint32_t)height;
+        header.width = (uint32_t)width;
+        header.pitchOrLinearSize = (uint32_t)(((width + 3) / 4) * ((height + 3) / 4) * blockBytes());
+        header.mipMapCount = (uint32_t)mipCount;
+        header.reserved1[0] = fourCC("RGTX");
+        header.reserved1[1] = (uint32_t)(sourceLoadMs * 1000.0);
+        header.pfSize = 32;
+        header.pfFlags = 0x4;   // DDPF_FOURCC
+        header.pfFourCC = fourCC(format == BlockFormat::BC1 ? "DXT1" : "DXT5");
+        header.caps[0] = 0x1000 | 0x400000 | 0x8;   // texture, mipmap, complex
+        memcpy(storage.data(), &header, sizeof(header));
+    }
+
+    bool parse(const unsigned char *bytes, size_t size)
+    {
+        levels.clear();
+        DDSHeader header;
+        if (size < sizeof(header))
+            return false;
+        memcpy(&header, bytes, sizeof(header));
+        if (header.magic != fourCC("DDS ") || header.size != 124 || !(header.pfFlags & 0x4))
+            return false;
+        if (header.pfFourCC == fourCC("DXT1"))
+            format = BlockFormat::BC1;
+        else if (header.pfFourCC == fourCC("DXT5"))
+            format = BlockFormat::BC3;
+        else
+            return false;
+        width = (int)header.width;
+        height = (int)header.height;
+        sourceLoadMs = header.reserved1[0] == fourCC("RGTX") ? header.reserved1[1] / 1000.0 : 0.0;
+
+        size_t offset = sizeof(header);
+        int levelWidth = width, levelHeight = height;
+        for (uint32_t mip = 0; mip < max(1u, header.mipMapCount); mip++)
+        {
+            size_t levelSize = (size_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockBytes();
+            if (offset + levelSize > size)
+            {
+                levels.clear();
+                return false;
+            }
+            levels.push_back(CompressedLevel{levelWidth, levelHeight, bytes + offset, levelSize});
+            offset += levelSize;
+            levelWidth = max(1, levelWidth / 2);
+            levelHeight = max(1, levelHeight / 2);
+        }
+        return true;
+    }
+
+    // 2x2 box filter of an RGBA8 image, odd edges are clamped
+    static vector<unsigned char> downsample(const vector<unsigned char> &source, int sourceWidth, int sourceHeight)
+    {
+        int targetWidth = max(1, sourceWidth / 2), targetHeight = max(1, sourceHeight / 2);
+        vector<unsigned char> target((size_t)targetWidth * targetHeight * 4);
+        for (int y = 0; y < targetHeight; y++)
+            for (int x = 0; x < targetWidth; x++)
+            {
+                int x0 = min(x * 2, sourceWidth - 1), x1 = min(x * 2 + 1, sourceWidth - 1);
+                int y0 = min(y * 2, sourceHeight - 1), y1 = min(y * 2 + 1, sourceHeight - 1);
+                for (int c = 0; c < 4; c++)
+                {
+                    int sum = source[((size_t)y0 * sourceWidth + x0) * 4 + c] + source[((size_t)y0 * sourceWidth + x1) * 4 + c]
+                            + source[((size_t)y1 * sourceWidth + x0) * 4 + c] + source[((size_t)y1 * sourceWidth + x1) * 4 + c];
+                    target[((size_t)y * targetWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        return target;
+    }
+
+    void encodeLevel(const unsigned char *rgba, int levelWidth, int levelHeight, vector<unsigned char> &out) const
+    {
+        unsigned char block[16 * 4];
+        for (int by = 0; by < levelHeight; by += 4)
+            for (int bx = 0; bx < levelWidth; bx += 4)
+            {
+                // gather the 4x4 block, clamping at the image border for levels smaller than a block
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                    {
+                        int sx = min(bx + x, levelWidth - 1), sy = min(by + y, levelHeight - 1);
+                        memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * levelWidth + sx) * 4, 4);
+                    }
+                unsigned char encoded[16];
+                if (format == BlockFormat::BC3)
+                {
+                    encodeAlphaBlock(block, encoded);
+                    encodeColorBlock(block, encoded + 8);
+                }
+                else
+                {
+                    encodeColorBlock(block, encoded);
+                }
+                out.insert(out.end(), encoded, encoded + blockBytes());
+            }
+    }
+
+    static uint16_t packRGB565(const float color[3])
+    {
+        int r = (int)lround(min(max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+        int g = (int)lround(min(max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+        int b = (int)lround(min(max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackRGB565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // BC1 color block: endpoints at the extremes of the block's principal axis, four color mode
+    static void encodeColorBlock(const unsigned char *block, unsigned char *out)
+    {
+        float mean[3] = {0, 0, 0};
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += block[i * 4 + c] / 16.0f;
+
+        float covariance[6] = {0, 0, 0, 0, 0, 0};   // xx xy xz yy yz zz
+        for (int i = 0; i < 16; i++)
+        {
+            float d[3] = {block[i * 4] - mean[0], block[i * 4 + 1] - mean[1], block[i * 4 + 2] - mean[2]};
+            covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+            covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+        }
+        // principal axis by power iteration
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+            float length = sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+            if (length < 1e-6f)
+                break;
+            for (int c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float minProjection = 1e9f, maxProjection = -1e9f;
+        for (int i = 0; i < 16; i++)
+        {
+            float projection = 0.0f;
+            for (int c = 0; c < 3; c++)
+                projection += (block[i * 4 + c] - mean[c]) * axis[c];
+            minProjection = min(minProjection, projection);
+            maxProjection = max(maxProjection, projection);
+        }
+        float endpoint0[3], endpoint1[3];
+        for (int c = 0; c < 3; c++)
+        {
+            endpoint0[c] = mean[c] + axis[c] * maxProjection;
+            endpoint1[c] = mean[c] + axis[c] * minProjection;
+        }
+        uint16_t color0 = packRGB565(endpoint0), color1 = packRGB565(endpoint1);
+        // four color mode needs color0 > color1
+        if (color0 < color1)
+            swap(color0, color1);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestDistance = 1 << 30;
+                for (int p = 0; p < 4; p++)
+                {
+                    int distance = 0;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        int d = block[i * 4 + c] - palette[p][c];
+                        distance += d * d;
+                    }
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (i * 2);
+            }
+        }
+        out[0] = color0 & 0xff; out[1] = color0 >> 8;
+        out[2] = color1 & 0xff; out[3] = color1 >> 8;
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (indices >> (i * 8)) & 0xff;
+    }
+
+    // BC3 alpha block: min and max alpha as endpoints, eight interpolated values
+    static void encodeAlphaBlock(const unsigned char *block, unsigned char *out)
+    {
+        int alpha0 = 0, alpha1 = 255;
+        for (int i = 0; i < 16; i++)
+        {
+            alpha0 = max(alpha0, (int)block[i * 4 + 3]);
+            alpha1 = min(alpha1, (int)block[i * 4 + 3]);
+        }
+        uint64_t indices = 0;
+        if (alpha0 != alpha1)
+        {
+            int palette[8] = {alpha0, alpha1};
+            for (int p = 1; p < 7; p++)
+                palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestDistance = 256;
+                for (int p = 0; p < 8; p++)
+                {
+                    int distance = abs(block[i * 4 + 3] - palette[p]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= (uint64_t)best << (i * 3);
+            }
+        }
+        out[0] = (unsigned char)alpha0;
+        out[1] = (unsigned char)alpha1;
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (indices >> (i * 8)) & 0xff;
+    }
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/texture_compression.h>
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// S3TC formats, from GL_EXT_texture_compression_s3tc and GL_EXT_texture_sRGB (glad is generated without extensions)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// pixels of a decoded image file, freed with the object. Decoding needs no GL context, so it can run on
+// worker threads; only the upload has to happen on the render thread.
+// note: stbi_set_flip_vertically_on_load is global state in stb_image and must not change while decodes run.
+struct DecodedImage {
+    std::string path;
+    unsigned char *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+
+    DecodedImage() = default;
+    DecodedImage(const DecodedImage &) = delete;
+    DecodedImage &operator=(const DecodedImage &) = delete;
+
+    ~DecodedImage()
+    {
+        if (pixels)
+            stbi_image_free(pixels);
+    }
+};
+
+// decodes image file contents that are already in memory, safe to call from any thread. pixels stays null if they
+// couldn't be decoded. path is only kept for error messages.
+std::shared_ptr<DecodedImage> DecodeImageFromMemory(const std::string &path, const unsigned char *bytes, size_t size)
+{
+    std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+    image->path = path;
+    if (size > 0)
+        image->pixels = stbi_load_from_memory(bytes, (int)size, &image->width, &image->height, &image->components, 0);
+    return image;
+}
+
+std::shared_ptr<DecodedImage> DecodeImageFromMemory(const std::string &path, const std::vector<unsigned char> &bytes)
+{
+    return DecodeImageFromMemory(path, bytes.data(), bytes.size());
+}
+
+// uploads a decoded image as a mipmapped, repeating 2D texture. With gamma, color images are stored as sRGB.
+// Must run on the GL thread.
+unsigned int UploadTexture2D(const DecodedImage &image, bool gamma = false)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (image.pixels)
+    {
+        GLenum internalFormat = GL_RGB;
+        GLenum format = GL_RGB;
+        if (image.components == 1)
+        {
+            internalFormat = format = GL_RED;
+        }
+        else if (image.components == 3)
+        {
+            internalFormat = gamma ? GL_SRGB : GL_RGB;
+            format = GL_RGB;
+        }
+        else if (image.components == 4)
+        {
+            internalFormat = gamma ? GL_SRGB_ALPHA : GL_RGBA;
+            format = GL_RGBA;
+        }
+
+        GLState::Instance().BindTexture(0, GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+    }
+
+    return textureID;
+}
+
+GLenum CompressedInternalFormat(BlockFormat format, bool gamma)
+{
+    if (format == BlockFormat::BC1)
+        return gamma ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    return gamma ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+// uploads a block compressed texture with all of its precomputed mip levels. Must run on the GL thread.
+unsigned int UploadCompressedTexture2D(const CompressedTexture &texture, bool gamma = false)
+{
+    GLenum internalFormat = CompressedInternalFormat(texture.format, gamma);
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    GLState::Instance().BindTexture(0, GL_TEXTURE_2D, textureID);
+    for (unsigned int level = 0; level < texture.levels.size(); level++)
+    {
+        const CompressedLevel &mip = texture.levels[level];
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, mip.width, mip.height, 0, (GLsizei)mip.size, mip.data);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+// whether the current context exposes the given extension. Must run on the GL thread.
+bool HasGLExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// uploads six decoded faces (+X, -X, +Y, -Y, +Z, -Z) as a cubemap. Must run on the GL thread.
+unsigned int UploadCubemap(const std::vector<std::shared_ptr<DecodedImage>> &faces)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    GLState::Instance().BindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        const DecodedImage &face = *faces[i];
+        if (face.pixels)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, face.width, face.height, 0, GL_RGB, GL_UNSIGNED_BYTE, face.pixels);
+        else
+            std::cout << "Cubemap texture failed to load at path: " << face.path << std::endl;
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return textureID;
+}
+
+#endif
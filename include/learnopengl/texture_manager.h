@@ -0,0 +1,329 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/asset_archive.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/startup_profiler.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/texture_streaming.h>
+
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// one texture known to the TextureManager. Created on Acquire, uploaded on the first Resolve.
+struct TextureEntry {
+    string key;                 // canonical path(s) plus variant
+    uint64_t contentHash = 0;
+    GLenum target = GL_TEXTURE_2D;
+    bool gamma = false;
+    unsigned int id = 0;
+    int refs = 0;
+    unsigned int hits = 0;      // acquisitions served without decoding
+    size_t bytes = 0;           // estimated GPU memory, including mips
+    bool decoded = false;
+    vector<shared_ptr<DecodedImage>> images;    // one per face, dropped after upload
+    shared_ptr<CompressedTexture> compressed;   // set instead of images for block compressed textures
+    string name;                // path of the first acquisition, for reports
+    double loadMs = 0.0;        // time to decode, or to map / bake the compressed texture
+    bool baked = false;         // compressed texture was encoded by this acquisition
+};
+
+// Process-wide registry of loaded textures. Lookups go by canonical path first and then by a hash of the file
+// contents, so the same image is decoded and uploaded once no matter which model or path asks for it.
+// Textures are reference counted: every Acquire/Load needs a matching Release of the returned GL id.
+//
+// Acquire may run on any thread, Resolve, Load*, Release must run on the GL thread.
+class TextureManager
+{
+public:
+    static TextureManager &Instance()
+    {
+        static TextureManager manager;
+        return manager;
+    }
+
+    // looks up a 2D texture, decoding it if neither its path nor its contents are known yet.
+    shared_ptr<TextureEntry> Acquire(const string &path, bool gamma = false)
+    {
+        return acquire(vector<string>{path}, GL_TEXTURE_2D, gamma);
+    }
+
+    // GL id of an acquired texture, uploading it on first use. Waits if another thread is still decoding it.
+    unsigned int Resolve(const shared_ptr<TextureEntry> &entry)
+    {
+        vector<shared_ptr<DecodedImage>> images;
+        {
+            unique_lock<mutex> lock(registryMutex);
+            decodedCondition.wait(lock, [&entry] { return entry->decoded; });
+            if (entry->id != 0)
+                return entry->id;
+            images.swap(entry->images);
+        }
+
+        StartupTimer timer("texture", "upload " + entry->name);
+        unsigned int id;
+        if (entry->compressed)
+        {
+            id = streamer ? streamer->Upload(entry->compressed, entry->gamma) : UploadCompressedTexture2D(*entry->compressed, entry->gamma);
+            reportCompressed(*entry);
+            entry->compressed.reset();
+        }
+        else
+        {
+            id = entry->target == GL_TEXTURE_CUBE_MAP ? UploadCubemap(images) : UploadTexture2D(*images[0], entry->gamma);
+        }
+
+        lock_guard<mutex> lock(registryMutex);
+        entry->id = id;
+        byId[id] = entry;
+        return id;
+    }
+
+    unsigned int Load2D(const string &path, bool gamma = false)
+    {
+        return Resolve(Acquire(path, gamma));
+    }
+
+    unsigned int LoadCubemap(const vector<string> &faces)
+    {
+        return Resolve(acquire(faces, GL_TEXTURE_CUBE_MAP, false));
+    }
+
+    // new 2D color textures get block compressed (see texture_compression.h). Only enable this when the context
+    // supports S3TC, the baked textures are kept in TEXTURE_CACHE_DIRECTORY for later runs. Gamma textures need the
+    // sRGB S3TC formats as well, without srgb they stay uncompressed.
+    void EnableCompression(bool enabled, bool srgb)
+    {
+        lock_guard<mutex> lock(registryMutex);
+        compression = enabled;
+        srgbCompression = enabled && srgb;
+    }
+
+    // compressed textures uploaded from now on start at their mip tail and get their finer levels from streamer.
+    // The streamer has to stay set until all of the textures it streams are released.
+    void EnableStreaming(TextureStreamer *streamer)
+    {
+        this->streamer = streamer;
+    }
+
+    // drops one reference, the texture is deleted with the last one
+    void Release(unsigned int id)
+    {
+        lock_guard<mutex> lock(registryMutex);
+        auto found = byId.find(id);
+        if (found == byId.end())
+            return;
+        shared_ptr<TextureEntry> entry = found->second;
+        if (--entry->refs > 0)
+            return;
+        releasedSavedBytes += entry->hits * entry->bytes;
+        if (streamer)
+            streamer->Forget(entry->id);
+        GLState::Instance().ForgetTexture(entry->id);
+        glDeleteTextures(1, &entry->id);
+        byId.erase(found);
+        auto sameContent = byContent.find(contentKey(entry->contentHash, entry->gamma));
+        if (sameContent != byContent.end() && sameContent->second == entry)
+            byContent.erase(sameContent);
+        for (auto it = byPath.begin(); it != byPath.end();)
+            it = it->second == entry ? byPath.erase(it) : next(it);
+    }
+
+    void PrintStats()
+    {
+        lock_guard<mutex> lock(registryMutex);
+        size_t residentBytes = 0;
+        size_t savedBytes = releasedSavedBytes;
+        for (auto &item : byId)
+        {
+            residentBytes += item.second->bytes;
+            savedBytes += item.second->hits * item.second->bytes;
+        }
+        cout << "TEXTURES:: " << byId.size() << " resident (" << residentBytes / (1024.0 * 1024.0) << " MB), "
+             << pathHits + contentHits << " hits (" << pathHits << " by path, " << contentHits << " by content), "
+             << misses << " misses, " << savedBytes / (1024.0 * 1024.0) << " MB saved" << endl;
+    }
+
+private:
+    mutex registryMutex;
+    condition_variable decodedCondition;
+    unordered_map<string, shared_ptr<TextureEntry>> byPath;
+    unordered_map<uint64_t, shared_ptr<TextureEntry>> byContent;
+    unordered_map<unsigned int, shared_ptr<TextureEntry>> byId;
+    unsigned int pathHits = 0;
+    unsigned int contentHits = 0;
+    unsigned int misses = 0;
+    size_t releasedSavedBytes = 0;
+    bool compression = false;
+    bool srgbCompression = false;
+    TextureStreamer *streamer = nullptr;    // GL thread only
+
+    TextureManager() = default;
+
+    shared_ptr<TextureEntry> acquire(const vector<string> &paths, GLenum target, bool gamma)
+    {
+        string key = target == GL_TEXTURE_CUBE_MAP ? "cube:" : "";
+        for (const string &path : paths)
+            key += canonicalPath(path) + "|";
+        key += gamma ? "srgb" : "linear";
+
+        {
+            lock_guard<mutex> lock(registryMutex);
+            auto found = byPath.find(key);
+            if (found != byPath.end())
+            {
+                pathHits++;
+                return addReference(found->second);
+            }
+        }
+
+        // hash the file contents outside the lock; the bytes are decoded from memory if it turns out to be new
+        // a single 2D texture hashes like its file alone, so baked compressed textures can be found by the same hash
+        vector<AssetBytes> files(paths.size());
+        uint64_t hash = Fnv1a64(nullptr, 0);
+        bool readable = true;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            files[i] = AssetArchive::Instance().Read(paths[i]);
+            readable = readable && files[i].size > 0;
+            hash = Fnv1a64(files[i].data, files[i].size, hash);
+        }
+        if (target == GL_TEXTURE_CUBE_MAP)
+            hash = Fnv1a64((const unsigned char *)"cubemap", 7, hash);
+        bool useCompression = false;
+
+        shared_ptr<TextureEntry> entry;
+        {
+            lock_guard<mutex> lock(registryMutex);
+            auto found = byPath.find(key);
+            if (found != byPath.end())
+            {
+                pathHits++;
+                return addReference(found->second);
+            }
+            auto sameContent = byContent.find(contentKey(hash, gamma));
+            if (readable && sameContent != byContent.end())
+            {
+                contentHits++;
+                byPath[key] = sameContent->second;
+                return addReference(sameContent->second);
+            }
+            misses++;
+            useCompression = (gamma ? srgbCompression : compression) && target == GL_TEXTURE_2D && readable;
+            entry = make_shared<TextureEntry>();
+            entry->key = key;
+            entry->name = paths[0];
+            entry->contentHash = hash;
+            entry->target = target;
+            entry->gamma = gamma;
+            entry->refs = 1;
+            byPath[key] = entry;
+            // missing files all hash the same, they must not alias each other
+            if (readable)
+                byContent[contentKey(hash, gamma)] = entry;
+        }
+
+        auto loadStart = chrono::steady_clock::now();
+        vector<shared_ptr<DecodedImage>> images;
+        shared_ptr<CompressedTexture> compressed;
+        bool baked = false;
+        size_t bytes = 0;
+        if (useCompression)
+            compressed = loadCompressed(paths[0], files[0], hash, images, baked);
+        if (compressed)
+            bytes = compressed->CompressedBytes();
+        for (size_t i = images.size(); !compressed && i < paths.size(); i++)
+            images.push_back(DecodeImageFromMemory(paths[i], files[i].data, files[i].size));
+        for (const shared_ptr<DecodedImage> &image : images)
+        {
+            size_t levelBytes = (size_t)image->width * image->height * image->components;
+            // a full mip chain adds a third on top of the base level; cubemaps are uploaded without mips
+            bytes += target == GL_TEXTURE_2D ? levelBytes * 4 / 3 : levelBytes;
+        }
+
+        auto loadEnd = chrono::steady_clock::now();
+        StartupProfiler::Instance().Record("texture", (compressed ? (baked ? "bake " : "map ") : "decode ") + entry->name,
+                                           loadStart, loadEnd);
+        {
+            lock_guard<mutex> lock(registryMutex);
+            entry->images = images;
+            entry->compressed = compressed;
+            entry->baked = baked;
+            entry->loadMs = chrono::duration<double, milli>(loadEnd - loadStart).count();
+            entry->bytes = bytes;
+            entry->decoded = true;
+        }
+        decodedCondition.notify_all();
+        return entry;
+    }
+
+    shared_ptr<TextureEntry> addReference(const shared_ptr<TextureEntry> &entry)
+    {
+        entry->refs++;
+        entry->hits++;
+        return entry;
+    }
+
+    static uint64_t contentKey(uint64_t hash, bool gamma)
+    {
+        return gamma ? hash ^ 0x9e3779b97f4a7c15ull : hash;
+    }
+
+    // the baked texture for these file contents, encoding and storing it if there is none yet. Images that can't be
+    // compressed (decode failures, one or two components) are left decoded in images and null is returned.
+    static shared_ptr<CompressedTexture> loadCompressed(const string &path, const AssetBytes &file, uint64_t hash,
+                                                        vector<shared_ptr<DecodedImage>> &images, bool &baked)
+    {
+        shared_ptr<CompressedTexture> compressed = make_shared<CompressedTexture>();
+        string bakedPath = CompressedTexturePath(hash);
+        if (compressed->Load(bakedPath))
+            return compressed;
+
+        auto decodeStart = chrono::steady_clock::now();
+        shared_ptr<DecodedImage> image = DecodeImageFromMemory(path, file.data, file.size);
+        double decodeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - decodeStart).count();
+        if (!image->pixels || image->components < 3)
+        {
+            images.push_back(image);
+            return nullptr;
+        }
+        compressed->Encode(image->pixels, image->width, image->height, image->components, decodeMs);
+        compressed->Save(bakedPath);
+        baked = true;
+        return compressed;
+    }
+
+    static void reportCompressed(const TextureEntry &entry)
+    {
+        const CompressedTexture &texture = *entry.compressed;
+        double megabyte = 1024.0 * 1024.0;
+        cout << "TEXTURE::" << texture.FormatName() << " " << entry.name << " " << texture.width << "x" << texture.height
+             << " " << texture.UncompressedBytes() / megabyte << " MB -> " << texture.CompressedBytes() / megabyte << " MB, "
+             << (entry.baked ? "baked in " : "loaded in ") << entry.loadMs << " ms (decoding the source takes "
+             << texture.sourceLoadMs << " ms)" << endl;
+    }
+
+    static string canonicalPath(const string &path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+        // only in the asset archive
+        return AssetArchive::Normalize(path);
+    }
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/projected_size.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/upload_queue.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// mips up to this size (in texels along the longer side) are uploaded right away and never evicted
+const int STREAMING_TAIL_SIZE = 64;
+// streamed mip levels being read or waiting for their upload at the same time
+const unsigned int STREAMING_MAX_LOADS = 4;
+// levels finer than the on-screen footprint asks for, to make up for meshes that use only part of their textures
+const int STREAMING_LOD_BIAS = 1;
+
+// streaming state of one block compressed texture. The mip chain stays in the (memory-mapped) CompressedTexture,
+// the GL texture holds the levels from residentLevel down to the coarsest one.
+struct StreamedTexture {
+    unsigned int id = 0;                    // 0 once the texture is released
+    shared_ptr<CompressedTexture> source;
+    GLenum internalFormat = 0;
+    int tailLevel = 0;                      // finest level of the always resident tail
+    int residentLevel = 0;                  // finest level in GL
+    int wantedLevel = 0;                    // finest level asked for in requestFrame
+    float footprint = 0.0f;                 // largest on-screen size in requestFrame, in pixels
+    unsigned long requestFrame = 0;
+    bool loading = false;
+    size_t residentBytes = 0;               // streamed levels only, the tail doesn't count against the budget
+};
+
+// Streams the mip levels of block compressed textures by how large they show up on screen: textures start out with
+// only their mip tail, finer levels are read on the loader pool and uploaded through the upload queue once a mesh
+// using them gets close enough. When the streamed levels exceed the VRAM budget, the finest levels of the least
+// recently and least visibly used textures are dropped again.
+//
+// Per frame: BeginFrame, Request for everything drawn, then Update. All of it must run on the GL thread, and the
+// streamer must stay alive while uploads it queued can still be processed.
+class TextureStreamer
+{
+public:
+    TextureStreamer(ThreadPool &pool, GLUploadQueue &uploads, size_t budgetBytes)
+        : pool(pool), uploads(uploads), budgetBytes(budgetBytes)
+    {
+    }
+
+    TextureStreamer(const TextureStreamer &) = delete;
+    TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+    void SetBudget(size_t bytes) { budgetBytes = bytes; }
+
+    // uploads the mip tail of texture and returns its GL id. Textures that are no larger than the tail are uploaded
+    // whole and aren't streamed.
+    unsigned int Upload(const shared_ptr<CompressedTexture> &texture, bool gamma)
+    {
+        int tail = 0;
+        while (tail + 1 < (int)texture->levels.size() && max(texture->levels[tail].width, texture->levels[tail].height) > STREAMING_TAIL_SIZE)
+            tail++;
+        if (tail == 0)
+            return UploadCompressedTexture2D(*texture, gamma);
+
+        shared_ptr<StreamedTexture> streamed = make_shared<StreamedTexture>();
+        streamed->source = texture;
+        streamed->internalFormat = CompressedInternalFormat(texture->format, gamma);
+        streamed->tailLevel = streamed->residentLevel = streamed->wantedLevel = tail;
+
+        glGenTextures(1, &streamed->id);
+        GLState::Instance().BindTexture(0, GL_TEXTURE_2D, streamed->id);
+        for (int level = tail; level < (int)texture->levels.size(); level++)
+        {
+            const CompressedLevel &mip = texture->levels[level];
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, streamed->internalFormat, mip.width, mip.height, 0, (GLsizei)mip.size, mip.data);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, tail);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture->levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        textures[streamed->id] = streamed;
+        return streamed->id;
+    }
+
+    // stops streaming a texture that is about to be deleted. Loads still in flight for it are dropped.
+    void Forget(unsigned int id)
+    {
+        auto found = textures.find(id);
+        if (found == textures.end())
+            return;
+        residentBytes -= found->second->residentBytes;
+        found->second->id = 0;
+        textures.erase(found);
+    }
+
+    void BeginFrame(const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight)
+    {
+        frame++;
+        this->view = view;
+        this->projection = projection;
+        this->viewportHeight = viewportHeight;
+    }
+
+    // on-screen diameter in pixels of a world space bounding sphere with this frame's camera
+    float ProjectedSize(const glm::vec3 &center, float radius) const
+    {
+        return ProjectedSphereSize(center, radius, view, projection, viewportHeight);
+    }
+
+    // texture id is drawn this frame covering about pixels on screen. Ids that aren't streamed are ignored.
+    void Request(unsigned int id, float pixels)
+    {
+        auto found = textures.find(id);
+        if (found == textures.end() || pixels <= 0.0f)
+            return;
+        StreamedTexture &texture = *found->second;
+        const CompressedTexture &source = *texture.source;
+        // one texel per pixel is the level whose size matches the footprint
+        float texels = (float)max(source.width, source.height);
+        int level = pixels >= texels ? 0 : (int)floor(log2(texels / pixels)) - STREAMING_LOD_BIAS;
+        level = max(0, min(level, texture.tailLevel));
+        if (texture.requestFrame != frame)
+        {
+            texture.requestFrame = frame;
+            texture.wantedLevel = level;
+            texture.footprint = pixels;
+        }
+        else
+        {
+            texture.wantedLevel = min(texture.wantedLevel, level);
+            texture.footprint = max(texture.footprint, pixels);
+        }
+    }
+
+    // starts loading finer levels of the textures requested this frame, most visible first, making room in the
+    // budget by evicting levels of less useful textures.
+    void Update()
+    {
+        vector<shared_ptr<StreamedTexture>> byUsefulness;
+        byUsefulness.reserve(textures.size());
+        for (auto &item : textures)
+            byUsefulness.push_back(item.second);
+        sort(byUsefulness.begin(), byUsefulness.end(), [](const shared_ptr<StreamedTexture> &a, const shared_ptr<StreamedTexture> &b)
+        {
+            return moreUseful(*a, *b);
+        });
+
+        // the budget may have shrunk, or the last loads overshot it
+        while (residentBytes + loadingBytes > budgetBytes && evictLeastUseful(byUsefulness, nullptr))
+            ;
+
+        for (const shared_ptr<StreamedTexture> &texture : byUsefulness)
+        {
+            if (loads >= STREAMING_MAX_LOADS || texture->requestFrame != frame)
+                break;
+            if (texture->loading || texture->wantedLevel >= texture->residentLevel)
+                continue;
+            size_t levelBytes = texture->source->levels[texture->residentLevel - 1].size;
+            bool fits = true;
+            while (fits && residentBytes + loadingBytes + levelBytes > budgetBytes)
+                fits = evictLeastUseful(byUsefulness, texture.get());
+            if (!fits)
+                break;
+            load(texture, texture->residentLevel - 1);
+        }
+    }
+
+    size_t ResidentBytes() const { return residentBytes; }
+
+    void PrintStats() const
+    {
+        size_t fullBytes = 0;
+        for (auto &item : textures)
+            for (int level = 0; level < item.second->tailLevel; level++)
+                fullBytes += item.second->source->levels[level].size;
+        double megabyte = 1024.0 * 1024.0;
+        cout << "TEXTURES::STREAMING " << textures.size() << " streamed textures, " << residentBytes / megabyte << " of "
+             << fullBytes / megabyte << " MB of fine mips resident (budget " << budgetBytes / megabyte << " MB), "
+             << levelsLoaded << " levels loaded, " << levelsEvicted << " evicted" << endl;
+    }
+
+private:
+    ThreadPool &pool;
+    GLUploadQueue &uploads;
+    size_t budgetBytes;
+    unordered_map<unsigned int, shared_ptr<StreamedTexture>> textures;
+    size_t residentBytes = 0;
+    size_t loadingBytes = 0;
+    unsigned int loads = 0;
+    unsigned int levelsLoaded = 0;
+    unsigned int levelsEvicted = 0;
+    unsigned long frame = 0;
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    float viewportHeight = 1.0f;
+
+    static bool moreUseful(const StreamedTexture &a, const StreamedTexture &b)
+    {
+        if (a.requestFrame != b.requestFrame)
+            return a.requestFrame > b.requestFrame;
+        return a.footprint > b.footprint;
+    }
+
+    // drops the finest level of the least useful texture that has one to spare and is less useful than keep.
+    // Levels finer than what their texture was last asked for go first. Returns false if there is none.
+    bool evictLeastUseful(const vector<shared_ptr<StreamedTexture>> &byUsefulness, const StreamedTexture *keep)
+    {
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (auto it = byUsefulness.rbegin(); it != byUsefulness.rend(); ++it)
+            {
+                StreamedTexture &texture = **it;
+                if (&texture == keep || texture.id == 0 || texture.loading || texture.residentLevel >= texture.tailLevel)
+                    continue;
+                bool surplus = texture.requestFrame != frame || texture.residentLevel < texture.wantedLevel;
+                if (pass == 0 && !surplus)
+                    continue;
+                if (pass == 1 && keep && !moreUseful(*keep, texture))
+                    break;
+                evict(texture);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // a zero sized image gives the level's memory back, the texture stays complete from the new base level down
+    void evict(StreamedTexture &texture)
+    {
+        int level = texture.residentLevel;
+        GLState::Instance().BindTexture(0, GL_TEXTURE_2D, texture.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, 0, 0, 0, 0, nullptr);
+        texture.residentLevel = level + 1;
+        texture.residentBytes -= texture.source->levels[level].size;
+        residentBytes -= texture.source->levels[level].size;
+        levelsEvicted++;
+    }
+
+    // reads the level on the pool, which faults the mapped file in off the GL thread, then uploads it
+    void load(const shared_ptr<StreamedTexture> &texture, int level)
+    {
+        size_t levelBytes = texture->source->levels[level].size;
+        texture->loading = true;
+        loadingBytes += levelBytes;
+        loads++;
+        GLUploadQueue *uploads = &this->uploads;
+        pool.Submit([this, texture, level, uploads]()
+        {
+            const CompressedLevel &mip = texture->source->levels[level];
+            shared_ptr<vector<unsigned char>> bytes = make_shared<vector<unsigned char>>(mip.data, mip.data + mip.size);
+            uploads->Push([this, texture, level, bytes]() { finishLoad(*texture, level, *bytes); });
+        });
+    }
+
+    void finishLoad(StreamedTexture &texture, int level, const vector<unsigned char> &bytes)
+    {
+        texture.loading = false;
+        loadingBytes -= bytes.size();
+        loads--;
+        if (texture.id == 0)
+            return;
+        const CompressedLevel &mip = texture.source->levels[level];
+        GLState::Instance().BindTexture(0, GL_TEXTURE_2D, texture.id);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, mip.width, mip.height, 0, (GLsizei)bytes.size(), bytes.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        texture.residentLevel = level;
+        texture.residentBytes += bytes.size();
+        residentBytes += bytes.size();
+        levelsLoaded++;
+    }
+};
+
+#endif
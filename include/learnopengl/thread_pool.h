@@ -0,0 +1,88 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads executing submitted tasks in FIFO order.
+// Tasks must not touch OpenGL: there is no context on the worker threads, GL work goes through a GLUploadQueue.
+class ThreadPool
+{
+public:
+    // threadCount 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0) : stopping(false)
+    {
+        if (threadCount == 0)
+            threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0)
+            threadCount = 2;
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        Stop();
+    }
+
+    // tasks that haven't started yet are dropped, running ones are waited for. Call it before destroying what the
+    // tasks use when that goes away before the pool; tasks submitted afterwards never run.
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            tasks.clear();
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            if (worker.joinable())
+                worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void Submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping)
+                return;
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    unsigned int Size() const { return (unsigned int)workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping)
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+#endif
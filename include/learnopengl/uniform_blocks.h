@@ -0,0 +1,93 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/stream_ring.h>
+
+#include <cstring>
+using namespace std;
+
+// Uniform blocks all programs share, written once per frame instead of setting the same uniforms in every program.
+// GL 3.3 shaders can't pick their binding point, so Shader binds blocks with these names when a program links.
+//
+// The structs below mirror the std140 layout of the blocks in the shaders, which is why every vec3 is a vec4 and
+// scalars are padded to 16 bytes. Keep both sides in sync:
+//
+//   layout (std140) uniform FrameData {
+//       mat4 projection;
+//       mat4 view;
+//       vec4 viewPosition;      // xyz
+//   };
+//
+//   struct PointLight {
+//       vec4 position;          // xyz, for all four vectors
+//       vec4 ambient;
+//       vec4 diffuse;
+//       vec4 specular;
+//       float constant;
+//       float linear;
+//       float quadratic;
+//   };
+//   layout (std140) uniform LightData {
+//       PointLight pointLights[MAX_POINT_LIGHTS];
+//       int blinn;
+//   };
+enum UniformBlockBinding : GLuint {
+    FRAME_DATA_BINDING = 0,
+    LIGHT_DATA_BINDING = 1,
+};
+
+const int MAX_POINT_LIGHTS = 2;
+
+struct FrameData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPosition;
+};
+
+struct PointLightData {
+    glm::vec4 position;
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding;
+};
+
+struct LightData {
+    PointLightData pointLights[MAX_POINT_LIGHTS];
+    int blinn;
+    int padding[3];
+};
+
+static_assert(sizeof(FrameData) == 144, "FrameData must match the std140 layout of the block");
+static_assert(sizeof(PointLightData) == 80, "PointLightData must match the std140 layout of PointLight");
+static_assert(sizeof(LightData) == 80 * MAX_POINT_LIGHTS + 16, "LightData must match the std140 layout of the block");
+
+// binding point of the shared block with the given name, false for blocks a program has to bind itself
+inline bool UniformBlockBindingOf(const char *name, GLuint &binding)
+{
+    if (strcmp(name, "FrameData") == 0)
+        binding = FRAME_DATA_BINDING;
+    else if (strcmp(name, "LightData") == 0)
+        binding = LIGHT_DATA_BINDING;
+    else
+        return false;
+    return true;
+}
+
+// writes the frame's value of a shared block to ring and binds it to the block's binding point for all programs
+template <typename T>
+void StreamUniformBlock(StreamRing &ring, UniformBlockBinding binding, const T &value)
+{
+    StreamAllocation allocation = ring.Write(value);
+    if (allocation.data)
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.Buffer(), allocation.offset, allocation.size);
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef UPLOAD_QUEUE_H
+#define UPLOAD_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// GL work produced by loader threads, executed on the render thread (the one owning the GL context).
+// Any thread may Push, only the render thread may Process.
+class GLUploadQueue
+{
+public:
+    void Push(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        available.notify_one();
+    }
+
+    // blocks until there is at least one task to process
+    void WaitForWork()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this] { return !tasks.empty(); });
+    }
+
+    // runs queued tasks in order until budgetMs is spent. At least one task runs per call, so loading
+    // always makes progress even when a single upload is bigger than the budget. Returns the number of tasks run.
+    unsigned int Process(double budgetMs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        unsigned int executed = 0;
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (tasks.empty())
+                    break;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            executed++;
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= budgetMs)
+                break;
+        }
+        return executed;
+    }
+
+    bool Empty()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tasks.empty();
+    }
+
+private:
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+};
+
+#endif
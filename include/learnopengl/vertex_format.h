@@ -0,0 +1,460 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// processed vertex as it comes out of the importer and the mesh cache
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// texture coordinates up to this magnitude are stored as half floats, which keep 11 bits of precision below 2.0
+const float HALF_TEXCOORD_LIMIT = 2.0f;
+
+// maps quantized positions in [-1, 1] back to model space: position = quantized * scale + offset
+struct VertexQuantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+struct Half2 {
+    uint16_t x, y;
+};
+
+struct Snorm16x2 {
+    int16_t x, y;
+};
+
+struct Snorm16x4 {
+    int16_t x, y, z, w;
+};
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7c00);
+    if (exponent <= 0)
+    {
+        // too small for a normal half, stored as a denormal or zero
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    // rounding may carry into the exponent, which is still the right result
+    if (mantissa & 0x1000)
+        half++;
+    return (uint16_t)half;
+}
+
+int16_t FloatToSnorm16(float value)
+{
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (int16_t)std::lround(value * 32767.0f);
+}
+
+// Encodings of the vertex attributes. Each one names the shader input it feeds, its GL format and how it is
+// produced from a Vertex; a VertexFormat is put together from them.
+struct PositionFloat3 {
+    typedef glm::vec3 Storage;
+    static const char *Name() { return "aPos"; }
+    static const GLint components = 3;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &, Storage &out) { out = vertex.Position; }
+};
+
+// 16 bit positions inside the model's bounding box. Shaders reading them dequantize with positionScale and
+// positionOffset, which Model::Draw sets.
+struct PositionSnorm16 {
+    typedef Snorm16x4 Storage;  // w pads the attribute to 8 bytes
+    static const char *Name() { return "aPosQuantized"; }
+    static const GLint components = 3;
+    static const GLenum type = GL_SHORT;
+    static const GLboolean normalized = GL_TRUE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &quantization, Storage &out)
+    {
+        glm::vec3 position = (vertex.Position - quantization.offset) / quantization.scale;
+        out.x = FloatToSnorm16(position.x);
+        out.y = FloatToSnorm16(position.y);
+        out.z = FloatToSnorm16(position.z);
+        out.w = 0;
+    }
+};
+
+struct NormalFloat3 {
+    typedef glm::vec3 Storage;
+    static const char *Name() { return "aNormal"; }
+    static const GLint components = 3;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &, Storage &out) { out = vertex.Normal; }
+};
+
+// unit normal projected onto an octahedron and unfolded into a square. Decoded in the shader with
+//   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y)); float t = max(-n.z, 0.0);
+//   n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t); normal = normalize(n);
+struct NormalOctahedral {
+    typedef Snorm16x2 Storage;
+    static const char *Name() { return "aNormalOct"; }
+    static const GLint components = 2;
+    static const GLenum type = GL_SHORT;
+    static const GLboolean normalized = GL_TRUE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &, Storage &out)
+    {
+        glm::vec3 n = vertex.Normal;
+        float length = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        float x = length > 0.0f ? n.x / length : 0.0f;
+        float y = length > 0.0f ? n.y / length : 0.0f;
+        if (n.z < 0.0f)
+        {
+            float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+        out.x = FloatToSnorm16(x);
+        out.y = FloatToSnorm16(y);
+    }
+};
+
+struct TexCoordsFloat2 {
+    typedef glm::vec2 Storage;
+    static const char *Name() { return "aTexCoords"; }
+    static const GLint components = 2;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &, Storage &out) { out = vertex.TexCoords; }
+};
+
+struct TexCoordsHalf2 {
+    typedef Half2 Storage;
+    static const char *Name() { return "aTexCoords"; }
+    static const GLint components = 2;
+    static const GLenum type = GL_HALF_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &, Storage &out)
+    {
+        out.x = FloatToHalf(vertex.TexCoords.x);
+        out.y = FloatToHalf(vertex.TexCoords.y);
+    }
+};
+
+struct TangentFloat3 {
+    typedef glm::vec3 Storage;
+    static const char *Name() { return "aTangent"; }
+    static const GLint components = 3;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &, Storage &out) { out = vertex.Tangent; }
+};
+
+struct BitangentFloat3 {
+    typedef glm::vec3 Storage;
+    static const char *Name() { return "aBitangent"; }
+    static const GLint components = 3;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &, Storage &out) { out = vertex.Bitangent; }
+};
+
+// normal, tangent and bitangent as the quaternion rotating the unit axes onto them. A negative w marks a mirrored
+// bitangent. Decoded in the shader with
+//   T = vec3(1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y + q.w * q.z), 2 * (q.x * q.z - q.w * q.y));
+//   B = vec3(2 * (q.x * q.y - q.w * q.z), 1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z + q.w * q.x)) * sign(q.w);
+//   N = vec3(2 * (q.x * q.z + q.w * q.y), 2 * (q.y * q.z - q.w * q.x), 1 - 2 * (q.x * q.x + q.y * q.y));
+struct TangentFrameQuaternion {
+    typedef Snorm16x4 Storage;
+    static const char *Name() { return "aTangentFrame"; }
+    static const GLint components = 4;
+    static const GLenum type = GL_SHORT;
+    static const GLboolean normalized = GL_TRUE;
+    static void Encode(const Vertex &vertex, const VertexQuantization &, Storage &out)
+    {
+        glm::vec3 n = orthogonalOr(vertex.Normal, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        glm::vec3 t = orthogonalOr(vertex.Tangent, n, std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::vec3 b = glm::cross(n, t);
+        float handedness = glm::dot(b, vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+
+        // rotation matrix with columns t, b, n to quaternion
+        float q[4];   // x, y, z, w
+        float trace = t.x + b.y + n.z;
+        if (trace > 0.0f)
+        {
+            float s = std::sqrt(trace + 1.0f) * 2.0f;
+            q[3] = 0.25f * s;
+            q[0] = (b.z - n.y) / s;
+            q[1] = (n.x - t.z) / s;
+            q[2] = (t.y - b.x) / s;
+        }
+        else if (t.x > b.y && t.x > n.z)
+        {
+            float s = std::sqrt(1.0f + t.x - b.y - n.z) * 2.0f;
+            q[3] = (b.z - n.y) / s;
+            q[0] = 0.25f * s;
+            q[1] = (b.x + t.y) / s;
+            q[2] = (n.x + t.z) / s;
+        }
+        else if (b.y > n.z)
+        {
+            float s = std::sqrt(1.0f + b.y - t.x - n.z) * 2.0f;
+            q[3] = (n.x - t.z) / s;
+            q[0] = (b.x + t.y) / s;
+            q[1] = 0.25f * s;
+            q[2] = (n.y + b.z) / s;
+        }
+        else
+        {
+            float s = std::sqrt(1.0f + n.z - t.x - b.y) * 2.0f;
+            q[3] = (t.y - b.x) / s;
+            q[0] = (n.x + t.z) / s;
+            q[1] = (n.y + b.z) / s;
+            q[2] = 0.25f * s;
+        }
+        // q and -q are the same rotation, so the sign of w is free to carry the handedness. It must not
+        // quantize to zero for that.
+        float sign = q[3] < 0.0f ? -1.0f : 1.0f;
+        const float minimumW = 1.0f / 32767.0f;
+        if (std::fabs(q[3]) < minimumW)
+        {
+            float rest = std::sqrt(1.0f - minimumW * minimumW) / std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+            q[0] *= rest;
+            q[1] *= rest;
+            q[2] *= rest;
+            q[3] = minimumW * sign;
+        }
+        sign *= handedness;
+        out.x = FloatToSnorm16(q[0] * sign);
+        out.y = FloatToSnorm16(q[1] * sign);
+        out.z = FloatToSnorm16(q[2] * sign);
+        out.w = FloatToSnorm16(q[3] * sign);
+    }
+
+private:
+    // v made orthogonal to the unit vector axis and normalized, fallback (made orthogonal) if v is degenerate
+    static glm::vec3 orthogonalOr(glm::vec3 v, glm::vec3 axis, glm::vec3 fallback)
+    {
+        v = v - axis * glm::dot(axis, v);
+        if (glm::dot(v, v) < 1e-12f)
+            v = fallback - axis * glm::dot(axis, fallback);
+        return v / glm::length(v);
+    }
+};
+
+// one attribute of a VertexFormat
+struct VertexAttributeFormat {
+    const char *name;           // shader input
+    GLint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset;              // from the start of the vertex
+    void (*encode)(const Vertex &, const VertexQuantization &, unsigned char *);
+};
+
+template <typename Encoding>
+void EncodeVertexAttribute(const Vertex &vertex, const VertexQuantization &quantization, unsigned char *out)
+{
+    typename Encoding::Storage value;
+    Encoding::Encode(vertex, quantization, value);
+    memcpy(out, &value, sizeof(value));
+}
+
+// names of the vertex inputs a shader reads and their locations, -1 for inputs it doesn't have. The encoding of
+// each attribute follows from the name: aPos / aPosQuantized, aNormal / aNormalOct, aTexCoords,
+// aTangent + aBitangent / aTangentFrame.
+struct VertexInputs {
+    GLint position = 0;
+    GLint quantizedPosition = -1;
+    GLint normal = 1;
+    GLint octahedralNormal = -1;
+    GLint texCoords = 2;
+    GLint tangent = 3;
+    GLint bitangent = 4;
+    GLint tangentFrame = -1;
+
+    // everything in Vertex, at the locations Mesh always used
+    static VertexInputs All()
+    {
+        return VertexInputs();
+    }
+
+    // the inputs a linked shader declares and actually reads, from its active attributes. Must run on the GL thread.
+    static VertexInputs Of(const Shader &shader)
+    {
+        VertexInputs inputs;
+        inputs.position = inputs.normal = inputs.texCoords = inputs.tangent = inputs.bitangent = -1;
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(shader.ID, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(shader.ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        vector<GLchar> name((size_t)maxLength + 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(shader.ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+            string attribute(name.data(), (size_t)length);
+            GLint location = glGetAttribLocation(shader.ID, attribute.c_str());
+            if (attribute == PositionFloat3::Name())
+                inputs.position = location;
+            else if (attribute == PositionSnorm16::Name())
+                inputs.quantizedPosition = location;
+            else if (attribute == NormalFloat3::Name())
+                inputs.normal = location;
+            else if (attribute == NormalOctahedral::Name())
+                inputs.octahedralNormal = location;
+            else if (attribute == TexCoordsFloat2::Name())
+                inputs.texCoords = location;
+            else if (attribute == TangentFloat3::Name())
+                inputs.tangent = location;
+            else if (attribute == BitangentFloat3::Name())
+                inputs.bitangent = location;
+            else if (attribute == TangentFrameQuaternion::Name())
+                inputs.tangentFrame = location;
+        }
+        return inputs;
+    }
+
+    // the tangent frame is built from the normal as well, see TangentFrameQuaternion
+    bool NeedsNormals() const
+    {
+        return normal >= 0 || octahedralNormal >= 0 || tangentFrame >= 0;
+    }
+
+    bool NeedsTexCoords() const
+    {
+        return texCoords >= 0;
+    }
+
+    bool NeedsTangents() const
+    {
+        return tangent >= 0 || bitangent >= 0 || tangentFrame >= 0;
+    }
+};
+
+// interleaved layout of the vertices in a vertex buffer, put together from the attribute encodings above
+class VertexFormat
+{
+public:
+    vector<VertexAttributeFormat> attributes;
+    GLsizei stride = 0;
+    bool quantizedPositions = false;
+
+    template <typename Encoding>
+    VertexFormat &Add(GLint location)
+    {
+        static_assert(sizeof(typename Encoding::Storage) % 4 == 0, "attributes must keep 4 byte alignment");
+        attributes.push_back(VertexAttributeFormat{Encoding::Name(), location, Encoding::components, Encoding::type,
+                                                   Encoding::normalized, (GLuint)stride, &EncodeVertexAttribute<Encoding>});
+        stride += (GLsizei)sizeof(typename Encoding::Storage);
+        return *this;
+    }
+
+    // Vertex as it is in memory, which needs no packing
+    static VertexFormat Full()
+    {
+        return For(VertexInputs::All(), false);
+    }
+
+    // the smallest format that has everything the inputs read
+    static VertexFormat For(const VertexInputs &inputs, bool halfTexCoords)
+    {
+        VertexFormat format;
+        if (inputs.quantizedPosition >= 0)
+        {
+            format.Add<PositionSnorm16>(inputs.quantizedPosition);
+            format.quantizedPositions = true;
+        }
+        else
+        {
+            format.Add<PositionFloat3>(inputs.position >= 0 ? inputs.position : 0);
+        }
+        if (inputs.octahedralNormal >= 0)
+            format.Add<NormalOctahedral>(inputs.octahedralNormal);
+        else if (inputs.normal >= 0)
+            format.Add<NormalFloat3>(inputs.normal);
+        if (inputs.texCoords >= 0 && halfTexCoords)
+            format.Add<TexCoordsHalf2>(inputs.texCoords);
+        else if (inputs.texCoords >= 0)
+            format.Add<TexCoordsFloat2>(inputs.texCoords);
+        if (inputs.tangentFrame >= 0)
+            format.Add<TangentFrameQuaternion>(inputs.tangentFrame);
+        if (inputs.tangent >= 0)
+            format.Add<TangentFloat3>(inputs.tangent);
+        if (inputs.bitangent >= 0)
+            format.Add<BitangentFloat3>(inputs.bitangent);
+        return format;
+    }
+
+    // whether vertices in this format are byte for byte a Vertex, so they can be uploaded as they are
+    bool IsVertex() const
+    {
+        VertexFormat full = For(VertexInputs::All(), false);
+        if (stride != (GLsizei)sizeof(Vertex) || attributes.size() != full.attributes.size())
+            return false;
+        for (size_t i = 0; i < attributes.size(); i++)
+            if (attributes[i].encode != full.attributes[i].encode || attributes[i].offset != full.attributes[i].offset)
+                return false;
+        return true;
+    }
+
+    // sets the attribute pointers on the bound VAO, for the bound vertex buffer
+    void SetAttributes() const
+    {
+        for (const VertexAttributeFormat &attribute : attributes)
+        {
+            glEnableVertexAttribArray(attribute.location);
+            glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, stride,
+                                  (void*)(size_t)attribute.offset);
+        }
+    }
+
+    void Pack(const Vertex *vertices, size_t count, const VertexQuantization &quantization, unsigned char *out) const
+    {
+        for (size_t i = 0; i < count; i++, out += stride)
+            for (const VertexAttributeFormat &attribute : attributes)
+                attribute.encode(vertices[i], quantization, out + attribute.offset);
+    }
+
+    string Describe() const
+    {
+        string description;
+        for (const VertexAttributeFormat &attribute : attributes)
+            description += (description.empty() ? "" : " ") + string(attribute.name);
+        return description;
+    }
+};
+
+#endif
@@ -4,9 +4,13 @@ layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+// shared by all programs, written once per frame
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
@@ -0,0 +1,29 @@
+#version 430 core
+// blending.vs for IndirectDraws: the model matrix comes from the draw's entry in DrawData
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 7) in uint aDrawID;
+
+out vec2 TexCoords;
+
+// shared by all programs, written once per frame
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+struct Draw {
+    mat4 model;
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+layout (std430, binding = 0) readonly buffer DrawData {
+    Draw draws[];
+};
+
+void main()
+{
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * draws[aDrawID].model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+// per instance, see BillboardBatch
+layout (location = 2) in vec4 aPositionScale;   // xyz position, w scale
+layout (location = 3) in float aRotation;       // about the y axis, in radians
+
+out vec2 TexCoords;
+
+// shared by all programs, written once per frame
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+void main()
+{
+    TexCoords = aTexCoords;
+    vec3 local = aPos * aPositionScale.w;
+    float s = sin(aRotation);
+    float c = cos(aRotation);
+    vec3 world = vec3(c * local.x + s * local.z, local.y, c * local.z - s * local.x) + aPositionScale.xyz;
+    gl_Position = projection * view * vec4(world, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 430 core
+// model_lighting.vs for IndirectDraws: the model matrix and the dequantization come from the draw's entry in DrawData
+layout (location = 0) in vec3 aPosQuantized;
+layout (location = 1) in vec2 aNormalOct;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in uint aDrawID;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+// shared by all programs, written once per frame
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+struct Draw {
+    mat4 model;
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+layout (std430, binding = 0) readonly buffer DrawData {
+    Draw draws[];
+};
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    Draw draw = draws[aDrawID];
+    vec3 position = aPosQuantized * draw.positionScale.xyz + draw.positionOffset.xyz;
+    FragPos = vec3(draw.model * vec4(position, 1.0));
+    Normal = decodeOctahedral(aNormalOct);
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -1,18 +1,29 @@
 #version 330 core
 out vec4 FragColor;
 
+// vectors are vec4 to keep the std140 layout simple, only xyz is used
 struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
+    vec4 position;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
 
     float constant;
     float linear;
     float quadratic;
 };
 
+// shared by all programs, written once per frame
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+layout (std140) uniform LightData {
+    PointLight pointLights[2];
+    int blinn;
+};
+
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
@@ -23,21 +34,18 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform PointLight pointLight;
 uniform Material material;
-uniform bool blinn;
-
-uniform vec3 viewPosition;
+uniform int pointLightIndex;    // the light of pointLights this program is lit by
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    if (blinn) {
+    if (blinn != 0) {
         vec3 halfwayDir = normalize(lightDir + viewDir);
         spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
     } else {
@@ -45,14 +53,14 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
         spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
     }
     // attenuation
-    float distance = length(light.position - fragPos);
+    float distance = length(light.position.xyz - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 ambient = light.ambient.xyz * vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 diffuse = light.diffuse.xyz * diff * vec3(texture(material.texture_diffuse1, TexCoords));
 
 
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 specular = light.specular.xyz * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
 //     ambient *= attenuation;
 //     diffuse *= attenuation;
 //     specular *= attenuation;
@@ -62,7 +70,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 void main()
 {
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir);
+    vec3 viewDir = normalize(viewPosition.xyz - FragPos);
+    vec3 result = CalcPointLight(pointLights[pointLightIndex], normal, FragPos, viewDir);
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
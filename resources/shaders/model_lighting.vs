@@ -1,20 +1,36 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+// compact vertices: 16 bit positions in the model's bounding box, octahedral normals
+layout (location = 0) in vec3 aPosQuantized;
+layout (location = 1) in vec2 aNormalOct;
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
+// shared by all programs, written once per frame
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    vec3 position = aPosQuantized * positionScale + positionOffset;
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = decodeOctahedral(aNormalOct);
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
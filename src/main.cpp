@@ -9,12 +9,27 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <learnopengl/asset_archive.h>
+#include <learnopengl/billboard_batch.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/frustum.h>
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/process_memory.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/indirect_draws.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/startup_profiler.h>
+#include <learnopengl/stream_ring.h>
+#include <learnopengl/texture_manager.h>
+#include <learnopengl/texture_streaming.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/uniform_blocks.h>
+#include <learnopengl/upload_queue.h>
 
 #include <iostream>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -47,6 +62,26 @@ bool firstMouse = true;
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+bool firstFrameShown = false;
+bool sceneLoaded = false;
+// what the frustum culling of the current frame kept and dropped: objects, and the meshes of the objects kept
+VisibilityCounts objectVisibility;
+VisibilityCounts meshVisibility;
+
+// time per frame spent on uploading asynchronously loaded models
+const double UPLOAD_BUDGET_MS = 4.0;
+// video memory for streamed texture mips, on top of the always resident mip tails
+const size_t TEXTURE_STREAMING_BUDGET_MB = 128;
+// room a frame has in the stream ring for uniform blocks, indirect commands and per draw data
+const size_t STREAM_RING_FRAME_BYTES = 1024 * 1024;
+// clip planes of the camera
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+// point lights in the LightData uniform block, ourShader and corgiShader each use one
+const int SCENE_LIGHT = 0;
+const int CORGI_LIGHT = 1;
+// built by asset_packer; without it everything is loaded from the loose files under resources/
+const char *const ASSET_ARCHIVE = "resources.pak";
 
 struct PointLight {
     glm::vec3 position;
@@ -128,52 +163,15 @@ void DrawImGui(ProgramState *programState);
 
 unsigned int loadTexture(char const * path, bool gammaCorrection)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    stbi_set_flip_vertically_on_load(false);
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    StartupTimer timer("texture file", path);
+    return TextureManager::Instance().Load2D(path, gammaCorrection);
 }
 
 int main() {
+    // startup is timed from here until the scene is loaded and shown, see STARTUP_TIMING_FILE for the results
+    StartupProfiler::Instance();
+    StartupTimer windowPhase("window", "glfw init and window creation");
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -201,22 +199,43 @@ int main() {
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    windowPhase.Stop();
+
     // glad: load all OpenGL function pointers
     // ---------------------------------------
+    StartupTimer gladPhase("window", "glad");
     if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // the models are drawn with indirect multi-draws if the driver gave us GL 4.3 or later
+    if (IndirectDraws::Load((GLADloadproc) glfwGetProcAddress))
+        std::cout << "GL::INDIRECT multi-draw indirect path on" << std::endl;
+    else
+        std::cout << "GL::INDIRECT no GL 4.3, models are drawn the GL 3.3 way" << std::endl;
+    // per frame data is written straight into mapped memory if the driver has buffer storage
+    if (StreamRing::Load((GLADloadproc) glfwGetProcAddress))
+        std::cout << "GL::STREAM_RING persistently mapped" << std::endl;
+    else
+        std::cout << "GL::STREAM_RING no buffer storage, staged through glBufferSubData" << std::endl;
+    gladPhase.Stop();
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(false);
 
+    // store color textures block compressed with precomputed mips where the driver supports it. The sRGB S3TC
+    // formats gamma textures use come with either of the other two extensions.
+    TextureManager::Instance().EnableCompression(HasGLExtension("GL_EXT_texture_compression_s3tc"),
+                                                 HasGLExtension("GL_EXT_texture_sRGB") ||
+                                                 HasGLExtension("GL_EXT_texture_compression_s3tc_srgb"));
+
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
     if (programState->ImGuiEnabled) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
     // Init Imgui
+    StartupTimer imguiPhase("window", "imgui");
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO &io = ImGui::GetIO();
@@ -226,36 +245,77 @@ int main() {
 
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
+    imguiPhase.Stop();
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    GLState::Instance().Enable(GL_DEPTH_TEST, true);
+
 
+    // serve assets out of the packed archive if there is one
+    StartupTimer archivePhase("assets", "open archive");
+    if (!AssetArchive::Instance().Open(FileSystem::getPath(ASSET_ARCHIVE), FileSystem::getPath("")))
+        std::cout << "ASSETS:: no " << ASSET_ARCHIVE << ", loading loose files" << std::endl;
+    archivePhase.Stop();
 
     // build and compile shaders
     // -------------------------
     Shader ourShader("resources/shaders/model_lighting.vs", "resources/shaders/model_lighting.fs");
     Shader corgiShader("resources/shaders/corgi.vs", "resources/shaders/corgi.fs");
     Shader transparentShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
+    Shader billboardShader("resources/shaders/blending_instanced.vs", "resources/shaders/blending.fs");
     Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+    // counterparts of the model shaders reading the per draw data of IndirectDraws, only with GL 4.3
+    std::unique_ptr<Shader> ourIndirectShader, corgiIndirectShader, transparentIndirectShader;
+    if (IndirectDraws::Supported()) {
+        ourIndirectShader.reset(new Shader("resources/shaders/model_indirect.vs", "resources/shaders/model_lighting.fs"));
+        corgiIndirectShader.reset(new Shader("resources/shaders/model_indirect.vs", "resources/shaders/corgi.fs"));
+        transparentIndirectShader.reset(new Shader("resources/shaders/blending_indirect.vs", "resources/shaders/blending.fs"));
+    }
 
     // load models
     // -----------
-    Model shipModel("resources/objects/ship/StMaria.obj");
+    // models are imported on worker threads and uploaded a few meshes per frame, each one shows up once it is resident.
+    // nothing reads the mesh data back, so the CPU copies go away after the upload, and the vertex buffers only
+    // hold what the shader drawing the model reads
+    GLUploadQueue uploadQueue;
+    ThreadPool loaderPool;
+    // compressed textures start at a low mip, finer ones stream in as the camera gets close
+    TextureStreamer textureStreamer(loaderPool, uploadQueue, TEXTURE_STREAMING_BUDGET_MB * 1024 * 1024);
+    TextureManager::Instance().EnableStreaming(&textureStreamer);
+
+    Model shipModel;
     shipModel.SetShaderTextureNamePrefix("material.");
+    shipModel.keepMeshData = false;
+    shipModel.SetVertexInputs(VertexInputs::Of(ourShader));
+    shipModel.LoadAsync("resources/objects/ship/StMaria.obj", loaderPool, uploadQueue);
 
-    Model mastiffModel("resources/objects/mastiff/13458_Bullmastiff_v1_L3.obj");
+    Model mastiffModel;
     mastiffModel.SetShaderTextureNamePrefix("material.");
+    mastiffModel.keepMeshData = false;
+    mastiffModel.coneCulling = true;    // closed mesh, its back faces are never seen
+    mastiffModel.SetVertexInputs(VertexInputs::Of(ourShader));
+    mastiffModel.LoadAsync("resources/objects/mastiff/13458_Bullmastiff_v1_L3.obj", loaderPool, uploadQueue);
 
-    Model corgiModel("resources/objects/corgi/corgi.obj");
+    Model corgiModel;
     corgiModel.SetShaderTextureNamePrefix("material.");
+    corgiModel.keepMeshData = false;
+    corgiModel.coneCulling = true;    // closed mesh, its back faces are never seen
+    corgiModel.SetVertexInputs(VertexInputs::Of(corgiShader));
+    corgiModel.LoadAsync("resources/objects/corgi/corgi.obj", loaderPool, uploadQueue);
 
-    Model treeModel("resources/objects/tree/Tree.obj");
+    Model treeModel;
     treeModel.SetShaderTextureNamePrefix("material.");
+    treeModel.keepMeshData = false;
+    treeModel.SetVertexInputs(VertexInputs::Of(transparentShader));
+    treeModel.LoadAsync("resources/objects/tree/Tree.obj", loaderPool, uploadQueue);
 
-    Model cartModel("resources/objects/cart/Cart.obj");
+    Model cartModel;
     cartModel.SetShaderTextureNamePrefix("material.");
+    cartModel.keepMeshData = false;
+    cartModel.SetVertexInputs(VertexInputs::Of(ourShader));
+    cartModel.LoadAsync("resources/objects/cart/Cart.obj", loaderPool, uploadQueue);
 
     // configure light
     PointLight& pointLight = programState->pointLight;
@@ -270,14 +330,14 @@ int main() {
 
     // set vertices
     float planeVertices[] = {
-            // positions            // normals         // texcoords
-            3000.0f, -0.5f,  3000.0f,  0.0f, 1.0f, 0.0f,  10.0f,  0.0f,
-            -3000.0f, -0.5f,  3000.0f,  0.0f, 1.0f, 0.0f,   0.0f,  0.0f,
-            -3000.0f, -0.5f, -3000.0f,  0.0f, 1.0f, 0.0f,   0.0f, 10.0f,
-
-            3000.0f, -0.5f,  3000.0f,  0.0f, 1.0f, 0.0f,  10.0f,  0.0f,
-            -3000.0f, -0.5f, -3000.0f,  0.0f, 1.0f, 0.0f,   0.0f, 10.0f,
-            3000.0f, -0.5f, -3000.0f,  0.0f, 1.0f, 0.0f,  10.0f, 10.0f
+            // positions            // normal      // texcoords
+            3000.0f, -0.5f,  3000.0f,  0.0f, 1.0f,  10.0f,  0.0f,
+            -3000.0f, -0.5f,  3000.0f,  0.0f, 1.0f,   0.0f,  0.0f,
+            -3000.0f, -0.5f, -3000.0f,  0.0f, 1.0f,   0.0f, 10.0f,
+
+            3000.0f, -0.5f,  3000.0f,  0.0f, 1.0f,  10.0f,  0.0f,
+            -3000.0f, -0.5f, -3000.0f,  0.0f, 1.0f,   0.0f, 10.0f,
+            3000.0f, -0.5f, -3000.0f,  0.0f, 1.0f,  10.0f, 10.0f
     };
 
     float transparentVertices[] = {
@@ -337,42 +397,42 @@ int main() {
     };
 
     // plane VAO
+    StartupTimer buffersPhase("scene", "plane, bush and skybox buffers");
     unsigned int planeVAO, planeVBO;
     glGenVertexArrays(1, &planeVAO);
     glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
+    GLState::Instance().BindVertexArray(planeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
+    // the grass is drawn with the model shader, which reads octahedral normals: (0, 1) decodes to straight up
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glBindVertexArray(0);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(5 * sizeof(float)));
+    GLState::Instance().BindVertexArray(0);
 
-    // transparent VAO
-    unsigned int transparentVAO, transparentVBO;
-    glGenVertexArrays(1, &transparentVAO);
+    // transparent quad, only read as the vertex source of the bush batch, which sets up its own VAO
+    unsigned int transparentVBO;
     glGenBuffers(1, &transparentVBO);
-    glBindVertexArray(transparentVAO);
     glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
+
+    // bushes, all drawn at once from the transparent quad
+    BillboardBatch bushes;
+    bushes.Create(transparentVBO, 6);
 
     // skybox VAO
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    GLState::Instance().BindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    buffersPhase.Stop();
 
     // load textures
     unsigned int transparentTexture = loadTexture(FileSystem::getPath("resources/textures/clipart974955.png").c_str(), false);
@@ -386,6 +446,8 @@ int main() {
         glm::vec3( 1.5f, -0.3f, 11.0f),
         glm::vec3(-0.3f, -0.3f, -10.0f),
     };
+    for (const glm::vec3 &position : vegetation)
+        bushes.Add(BillboardInstance{position, 2.0f, 0.0f});
 
     // skybox textures
     vector<std::string> faces
@@ -401,12 +463,13 @@ int main() {
 
     // configure floating point framebuffer
     // ------------------------------------
+    StartupTimer framebufferPhase("scene", "hdr framebuffer");
     unsigned int hdrFBO;
     glGenFramebuffers(1, &hdrFBO);
     // create floating point color buffer
     unsigned int colorBuffer;
     glGenTextures(1, &colorBuffer);
-    glBindTexture(GL_TEXTURE_2D, colorBuffer);
+    GLState::Instance().BindTexture(0, GL_TEXTURE_2D, colorBuffer);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -422,10 +485,30 @@ int main() {
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    framebufferPhase.Stop();
 
     // shader configuration
     ourShader.use();
     ourShader.setInt("texture1", 0);
+    ourShader.setInt("pointLightIndex", SCENE_LIGHT);
+    ourShader.setFloat("material.shininess", 32.0f);
+
+    corgiShader.use();
+    corgiShader.setInt("pointLightIndex", CORGI_LIGHT);
+    corgiShader.setFloat("material.shininess", 64.0f);
+
+    if (IndirectDraws::Supported()) {
+        ourIndirectShader->use();
+        ourIndirectShader->setInt("pointLightIndex", SCENE_LIGHT);
+        ourIndirectShader->setFloat("material.shininess", 32.0f);
+
+        corgiIndirectShader->use();
+        corgiIndirectShader->setInt("pointLightIndex", CORGI_LIGHT);
+        corgiIndirectShader->setFloat("material.shininess", 64.0f);
+
+        transparentIndirectShader->use();
+        transparentIndirectShader->setInt("texture1", 0);
+    }
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
@@ -433,12 +516,24 @@ int main() {
     transparentShader.use();
     transparentShader.setInt("texture1", 0);
 
+    billboardShader.use();
+    billboardShader.setInt("texture1", 0);
+
     hdrShader.use();
     hdrShader.setInt("hdrBuffer", 0);
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    RenderQueue renderQueue;
+    StreamRing streamRing;
+    streamRing.Create(STREAM_RING_FRAME_BYTES);
+    IndirectDraws indirectDraws;
+    if (IndirectDraws::Supported())
+        indirectDraws.Create();
+    VisibilityCounts objectVisibilityTotal, meshVisibilityTotal;
+    size_t culledFrames = 0;
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window)) {
@@ -452,6 +547,16 @@ int main() {
         // -----
         processInput(window);
 
+        // finish pending model uploads, within the frame's budget
+        uploadQueue.Process(UPLOAD_BUDGET_MS);
+        if (!sceneLoaded && shipModel.resident && mastiffModel.resident && corgiModel.resident && treeModel.resident && cartModel.resident) {
+            TextureManager::Instance().PrintStats();
+            AssetArchive::Instance().PrintStats();
+            std::cout << "MEMORY:: resident set " << ResidentSetBytes() / (1024.0 * 1024.0) << " MB with the scene loaded" << std::endl;
+            StartupProfiler::Instance().Milestone("scene loaded");
+            sceneLoaded = true;
+        }
+
         glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
 
             // render
@@ -459,25 +564,61 @@ int main() {
             glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            // don't forget to enable shader before setting uniforms
-            corgiShader.use();
-            corgiShader.setVec3("pointLight.position", glm::vec3(1.0f, 1.0f, 0.01f));
-            corgiShader.setVec3("pointLight.ambient", pointLight.ambient + glm::vec3(4.0f));
-            corgiShader.setVec3("pointLight.diffuse", pointLight.diffuse + glm::vec3(6.0f));
-            corgiShader.setVec3("pointLight.specular", glm::vec3(4.0f));
-            corgiShader.setFloat("pointLight.constant", pointLight.constant);
-            corgiShader.setFloat("pointLight.linear", pointLight.linear);
-            corgiShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-            corgiShader.setVec3("viewPosition", programState->camera.Position);
-            corgiShader.setFloat("material.shininess", 64.0f);
-            corgiShader.setInt("blinn", blinnBool);
-
             // view/projection transformations
             glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                    (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                                    (float) SCR_WIDTH / (float) SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
             glm::mat4 view = programState->camera.GetViewMatrix();
-            corgiShader.setMat4("projection", projection);
-            corgiShader.setMat4("view", view);
+            textureStreamer.BeginFrame(view, projection, (float) SCR_HEIGHT);
+
+            // every object submits its draws to the render queue, which runs them sorted by pass, program, texture
+            // and VAO. What all programs share comes from the uniform blocks, the rest is set per draw.
+            renderQueue.BeginFrame(FAR_PLANE);
+            // objects outside the view frustum aren't submitted at all, models test their meshes after that
+            Frustum viewFrustum = Frustum::FromMatrix(projection * view);
+            objectVisibility = meshVisibility = VisibilityCounts();
+            // the frame's uniform blocks and indirect draws go to the stream ring, in a region the GPU is done with
+            streamRing.BeginFrame();
+            // camera and lights go to the uniform blocks all programs share, once for the whole frame
+            FrameData frameData;
+            frameData.projection = projection;
+            frameData.view = view;
+            frameData.viewPosition = glm::vec4(programState->camera.Position, 1.0f);
+            StreamUniformBlock(streamRing, FRAME_DATA_BINDING, frameData);
+            LightData lightData;
+            lightData.pointLights[SCENE_LIGHT] = PointLightData{glm::vec4(pointLight.position, 1.0f), glm::vec4(pointLight.ambient, 0.0f),
+                                                                glm::vec4(pointLight.diffuse, 0.0f), glm::vec4(pointLight.specular, 0.0f),
+                                                                pointLight.constant, pointLight.linear, pointLight.quadratic, 0.0f};
+            // the corgi gets a brighter light close by
+            lightData.pointLights[CORGI_LIGHT] = PointLightData{glm::vec4(1.0f, 1.0f, 0.01f, 1.0f), glm::vec4(pointLight.ambient + glm::vec3(4.0f), 0.0f),
+                                                                glm::vec4(pointLight.diffuse + glm::vec3(6.0f), 0.0f), glm::vec4(glm::vec3(4.0f), 0.0f),
+                                                                pointLight.constant, pointLight.linear, pointLight.quadratic, 0.0f};
+            lightData.blinn = blinnBool;
+            StreamUniformBlock(streamRing, LIGHT_DATA_BINDING, lightData);
+
+            // models are drawn with the model matrix set by their packet, or with indirectShader (null without GL 4.3)
+            // from the commands they add to indirectDraws
+            indirectDraws.BeginFrame();
+            auto submitModel = [&](RenderPass pass, Shader &shader, Shader *indirectShader, Model &object, const glm::mat4 &model,
+                                   const glm::vec3 &position) {
+                if (!object.resident)
+                    return;
+                bool visible = viewFrustum.Intersects(object.WorldBounds(model));
+                objectVisibility.Count(visible);
+                if (!visible)
+                    return;
+                object.SelectLod(model, view, projection, (float) SCR_HEIGHT);
+                object.Cull(model, view, projection);
+                meshVisibility += object.MeshVisibility();
+                if (indirectShader) {
+                    object.SubmitIndirect(indirectDraws, model);
+                    renderQueue.Submit(pass, *indirectShader, 0, GL_TEXTURE_2D, 0, RenderQueue::ViewDepth(view, position), RenderState(),
+                                       DrawCall::OfIndirect(object, indirectDraws));
+                } else {
+                    renderQueue.Submit(pass, shader, 0, GL_TEXTURE_2D, 0, RenderQueue::ViewDepth(view, position), RenderState(),
+                                       DrawCall::OfModel(object, model));
+                }
+                object.RequestTextureDetail(textureStreamer, model);
+            };
 
             // render corgi
             glm::mat4 model = glm::mat4(1.0f);
@@ -485,34 +626,15 @@ int main() {
                                    programState->corgiPosition); // translate it down so it's at the center of the scene
             model = glm::scale(model, glm::vec3(programState->corgiScale));
             model = glm::rotate(model, glm::radians(programState->corgiAngle), programState->corgiRotation);
-            corgiShader.setMat4("model", model);
-            corgiModel.Draw(corgiShader);
-
-            ourShader.use();
-            ourShader.setVec3("pointLight.position", pointLight.position);
-            ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-            ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-            ourShader.setVec3("pointLight.specular", pointLight.specular);
-            ourShader.setFloat("pointLight.constant", pointLight.constant);
-            ourShader.setFloat("pointLight.linear", pointLight.linear);
-            ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-            ourShader.setVec3("viewPosition", programState->camera.Position);
-            ourShader.setFloat("material.shininess", 32.0f);
-            ourShader.setInt("blinn", blinnBool);
-
-            ourShader.setMat4("projection", projection);
-            ourShader.setMat4("view", view);
-
+            submitModel(RENDER_PASS_OPAQUE, corgiShader, corgiIndirectShader.get(), corgiModel, model, programState->corgiPosition);
 
             // render ship
-            ourShader.use();
             model = glm::mat4(1.0f);
             model = glm::translate(model,
                                    programState->shipPosition); // translate it down so it's at the center of the scene
             model = glm::scale(model, glm::vec3(programState->shipScale));    // it's a bit too big for our scene, so scale it down
             model = glm::rotate(model, glm::radians(programState->shipAngle), programState->shipRotation);
-            ourShader.setMat4("model", model);
-            shipModel.Draw(ourShader);
+            submitModel(RENDER_PASS_OPAQUE, ourShader, ourIndirectShader.get(), shipModel, model, programState->shipPosition);
 
             // render mastiff
             model = glm::mat4(1.0f);
@@ -520,40 +642,45 @@ int main() {
                                    programState->mastiffPosition); // translate it down so it's at the center of the scene
             model = glm::scale(model, glm::vec3(programState->mastiffScale));    // it's a bit too big for our scene, so scale it down
             model = glm::rotate(model, glm::radians(programState->mastiffAngle), programState->mastiffRotation);
-            ourShader.setMat4("model", model);
-            mastiffModel.Draw(ourShader);
+            submitModel(RENDER_PASS_OPAQUE, ourShader, ourIndirectShader.get(), mastiffModel, model, programState->mastiffPosition);
 
             // render cart
-            ourShader.use();
             model = glm::mat4(1.0f);
             model = glm::translate(model,
                                    programState->cartPosition); // translate it down so it's at the center of the scene
             model = glm::scale(model, glm::vec3(programState->cartScale));
-            ourShader.setMat4("model", model);
-            cartModel.Draw(ourShader);
-
-            // render grass with face-culling
-            glEnable(GL_CULL_FACE);
-            glCullFace(GL_FRONT);
-            glBindVertexArray(planeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, grassTexture);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glDisable(GL_CULL_FACE);
-
-            // render bush
-            transparentShader.use();
-            transparentShader.setMat4("projection", projection);
-            transparentShader.setMat4("view", view);
-            glBindVertexArray(transparentVAO);
-            glBindTexture(GL_TEXTURE_2D, transparentTexture);
-            for (unsigned int i = 0; i < vegetation.size(); i++)
+            submitModel(RENDER_PASS_OPAQUE, ourShader, ourIndirectShader.get(), cartModel, model, programState->cartPosition);
+
+            // render grass with face-culling, the plane is laid out in the cart's model space
+            Bounds grassBounds = Bounds::OfBox(glm::vec3(-3000.0f, -0.5f, -3000.0f), glm::vec3(3000.0f, -0.5f, 3000.0f)).Transformed(model);
+            bool grassVisible = viewFrustum.Intersects(grassBounds);
+            objectVisibility.Count(grassVisible);
+            if (grassVisible)
+            {
+                RenderState grassState;
+                grassState.cullFrontFaces = true;
+                renderQueue.Submit(RENDER_PASS_OPAQUE, ourShader, planeVAO, GL_TEXTURE_2D, grassTexture, 0.0f, grassState,
+                                   DrawCall::OfFloatTriangles(6, model));
+                // one grass tile (600 units) right below the camera
+                textureStreamer.Request(grassTexture, textureStreamer.ProjectedSize(
+                        glm::vec3(programState->camera.Position.x, -0.5f, programState->camera.Position.z), 300.0f));
+            }
+
+            // render bushes, one instanced draw for all of them, culled as a whole. Only instances changed since the last
+            // frame are uploaded.
+            bushes.Upload();
+            bool bushesVisible = bushes.Size() > 0 && viewFrustum.Intersects(bushes.WorldBounds());
+            if (bushes.Size() > 0)
+                objectVisibility.Count(bushesVisible);
+            if (bushesVisible)
             {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, vegetation[i]);
-                model = glm::scale(model, glm::vec3(2.0f));
-                transparentShader.setMat4("model", model);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+                renderQueue.Submit(RENDER_PASS_ALPHA_TESTED, billboardShader, bushes.VAO, GL_TEXTURE_2D, transparentTexture,
+                                   RenderQueue::ViewDepth(view, bushes.Center()), RenderState(),
+                                   DrawCall::OfBillboards(bushes));
+                // the nearest bush needs the most texture detail
+                const BillboardInstance &nearest = bushes.Nearest(programState->camera.Position);
+                textureStreamer.Request(transparentTexture, textureStreamer.ProjectedSize(
+                        nearest.position + glm::vec3(0.5f, 0.5f, 0.0f) * nearest.scale, 0.75f * nearest.scale));
             }
 
             // render tree
@@ -561,22 +688,25 @@ int main() {
             model = glm::translate(model,
                                    programState->treePosition); // translate it down so it's at the center of the scene
             model = glm::scale(model, glm::vec3(programState->treeScale));
-            transparentShader.setMat4("model", model);
-            treeModel.Draw(transparentShader);
-
-            // draw skybox
-            glDepthFunc(GL_LEQUAL);
-            skyboxShader.use();
-            view = glm::mat4(glm::mat3(view));
-            skyboxShader.setMat4("view", view);
-            skyboxShader.setMat4("projection", projection);
-            // skybox cube
-            glBindVertexArray(skyboxVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-            glBindVertexArray(0);
-            glDepthFunc(GL_LESS); // set depth function back to default
+            submitModel(RENDER_PASS_ALPHA_TESTED, transparentShader, transparentIndirectShader.get(), treeModel, model, programState->treePosition);
+
+            // draw skybox, at the far plane it passes the depth test only where nothing else was drawn
+            RenderState skyboxState;
+            skyboxState.depthFunc = GL_LEQUAL;
+            renderQueue.Submit(RENDER_PASS_SKY, skyboxShader, skyboxVAO, GL_TEXTURE_CUBE_MAP, cubemapTexture, FAR_PLANE, skyboxState,
+                               DrawCall::OfTriangles(36));
+
+            if (IndirectDraws::Supported())
+                indirectDraws.Upload(streamRing);
+            streamRing.Flush();
+            renderQueue.Execute();
+            streamRing.EndFrame();
+            objectVisibilityTotal += objectVisibility;
+            meshVisibilityTotal += meshVisibility;
+            culledFrames++;
+
+            // stream in the texture detail asked for by this frame's draws, the uploads happen over the next frames
+            textureStreamer.Update();
 
             if (programState->ImGuiEnabled)
                 DrawImGui(programState);
@@ -586,8 +716,7 @@ int main() {
         // hdr implementation
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         hdrShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffer);
+        GLState::Instance().BindTexture(0, GL_TEXTURE_2D, colorBuffer);
         hdrShader.setInt("hdr", hdr);
         hdrShader.setFloat("exposure", exposure);
         renderQuad();
@@ -598,8 +727,22 @@ int main() {
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+        GLState::Instance().EndFrame();
+
+        if (!firstFrameShown) {
+            std::cout << "FRAME::FIRST " << glfwGetTime() * 1000.0 << " ms after startup" << std::endl;
+            StartupProfiler::Instance().Milestone("first frame");
+            firstFrameShown = true;
+        }
+        // startup ends once the whole scene is on screen
+        if (sceneLoaded && !StartupProfiler::Instance().Finished())
+            StartupProfiler::Instance().Finish();
     }
 
+    // imports and texture reads still running on the pool use the models and the streamer, which are destroyed
+    // before the pool, so wait for them here and drop what hasn't started
+    loaderPool.Stop();
+
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
@@ -607,14 +750,43 @@ int main() {
     ImGui::DestroyContext();
 
     // free memory
+    textureStreamer.PrintStats();
+    renderQueue.PrintStats();
+    double culledFramesDivisor = culledFrames > 0 ? (double) culledFrames : 1.0;
+    std::cout << "CULLING::FRUSTUM " << culledFrames << " frames, per frame visible / culled: objects "
+              << objectVisibilityTotal.visible / culledFramesDivisor << " / " << objectVisibilityTotal.culled / culledFramesDivisor
+              << ", meshes " << meshVisibilityTotal.visible / culledFramesDivisor << " / "
+              << meshVisibilityTotal.culled / culledFramesDivisor << std::endl;
+    if (IndirectDraws::Supported())
+        indirectDraws.PrintStats();
+    streamRing.PrintStats();
+    GLState::Instance().PrintStats();
+    shipModel.PrintCullStats();
+    mastiffModel.PrintCullStats();
+    corgiModel.PrintCullStats();
+    treeModel.PrintCullStats();
+    cartModel.PrintCullStats();
+    shipModel.Release();
+    mastiffModel.Release();
+    corgiModel.Release();
+    treeModel.Release();
+    cartModel.Release();
+    TextureManager::Instance().Release(transparentTexture);
+    TextureManager::Instance().Release(grassTexture);
+    TextureManager::Instance().Release(cubemapTexture);
+    TextureManager::Instance().EnableStreaming(nullptr);
+
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &planeVBO);
 
-    glDeleteVertexArrays(1, &transparentVAO);
     glDeleteBuffers(1, &transparentVBO);
+    bushes.Delete();
 
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
+    streamRing.Delete();
+    if (IndirectDraws::Supported())
+        indirectDraws.Delete();
 
     glfwTerminate();
     return 0;
@@ -636,7 +808,7 @@ void renderQuad()
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        GLState::Instance().BindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -644,9 +816,8 @@ void renderQuad()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    GLState::Instance().BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -779,6 +950,8 @@ void DrawImGui(ProgramState *programState) {
         ImGui::Text("Camera position: (%f, %f, %f)", c.Position.x, c.Position.y, c.Position.z);
         ImGui::Text("(Yaw, Pitch): (%f, %f)", c.Yaw, c.Pitch);
         ImGui::Text("Camera front: (%f, %f, %f)", c.Front.x, c.Front.y, c.Front.z);
+        ImGui::Text("Objects visible / culled: %zu / %zu", objectVisibility.visible, objectVisibility.culled);
+        ImGui::Text("Meshes visible / culled: %zu / %zu", meshVisibility.visible, meshVisibility.culled);
         ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
         ImGui::End();
     }
@@ -808,30 +981,6 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 
 unsigned int loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
\ No newline at end of file
+    StartupTimer timer("cubemap", faces.empty() ? "" : faces[0]);
+    return TextureManager::Instance().LoadCubemap(faces);
+}
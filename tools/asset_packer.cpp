@@ -0,0 +1,158 @@
+// Packs asset files into one archive for AssetArchive (see include/learnopengl/asset_archive.h). Run it from the
+// project root, listing files and directories in the order the game loads them, so the archive reads front to back:
+//   ./asset_packer resources.pak resources/shaders resources/textures resources/objects
+// Directories are packed recursively in name order. Entries are LZ4 compressed where that saves at least an eighth
+// of their size, unless --store is given.
+#include <learnopengl/asset_archive.h>
+#include <learnopengl/lz4.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static void collect(const std::string &path, std::vector<std::string> &files)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+    {
+        std::cout << "ERROR::ASSET_PACKER:: " << path << " does not exist" << std::endl;
+        return;
+    }
+    if (!S_ISDIR(st.st_mode))
+    {
+        files.push_back(path);
+        return;
+    }
+    DIR *directory = opendir(path.c_str());
+    if (!directory)
+        return;
+    std::vector<std::string> children;
+    while (dirent *child = readdir(directory))
+        if (std::strcmp(child->d_name, ".") != 0 && std::strcmp(child->d_name, "..") != 0)
+            children.push_back(child->d_name);
+    closedir(directory);
+    std::sort(children.begin(), children.end());
+    for (const std::string &child : children)
+        collect(path + "/" + child, files);
+}
+
+static void pad(std::ofstream &out, uint64_t &offset, uint64_t alignment)
+{
+    static const char zeros[ASSET_ARCHIVE_ALIGNMENT] = {0};
+    uint64_t padding = (alignment - offset % alignment) % alignment;
+    out.write(zeros, (std::streamsize)padding);
+    offset += padding;
+}
+
+int main(int argc, char **argv)
+{
+    bool compress = true;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--store") == 0)
+            compress = false;
+        else
+            arguments.push_back(argv[i]);
+    }
+    if (arguments.size() < 2)
+    {
+        std::cout << "usage: " << argv[0] << " [--store] <archive> <file or directory>..." << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    for (size_t i = 1; i < arguments.size(); i++)
+        collect(arguments[i], files);
+
+    std::string tempPath = arguments[0] + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cout << "ERROR::ASSET_PACKER:: could not write " << tempPath << std::endl;
+        return 1;
+    }
+    ArchiveHeader header;
+    std::memset(&header, 0, sizeof(header));
+    out.write((const char *)&header, sizeof(header));
+    uint64_t offset = sizeof(header);
+
+    std::vector<ArchiveEntry> entries;
+    std::string names;
+    uint64_t sourceBytes = 0;
+    int failures = 0;
+    for (const std::string &path : files)
+    {
+        std::ifstream in(path, std::ios::binary);
+        struct stat st;
+        if (!in || stat(path.c_str(), &st) != 0)
+        {
+            std::cout << "ERROR::ASSET_PACKER:: could not read " << path << std::endl;
+            failures++;
+            continue;
+        }
+        std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        ArchiveEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        std::string name = AssetArchive::Normalize(path);
+        entry.nameOffset = (uint32_t)names.size();
+        entry.nameLength = (uint32_t)name.size();
+        names += name;
+        entry.size = file.size();
+        entry.sourceMtime = (int64_t)st.st_mtime;
+        entry.compression = ARCHIVE_STORED;
+
+        std::vector<unsigned char> compressed;
+        if (compress && !file.empty())
+        {
+            compressed.resize(Lz4CompressBound(file.size()));
+            compressed.resize(Lz4Compress(file.data(), file.size(), compressed.data()));
+            if (compressed.size() <= file.size() - file.size() / 8)
+                entry.compression = ARCHIVE_LZ4;
+        }
+        const std::vector<unsigned char> &payload = entry.compression == ARCHIVE_LZ4 ? compressed : file;
+
+        pad(out, offset, ASSET_ARCHIVE_ALIGNMENT);
+        entry.offset = offset;
+        entry.storedSize = payload.size();
+        out.write((const char *)payload.data(), (std::streamsize)payload.size());
+        offset += payload.size();
+        entries.push_back(entry);
+        sourceBytes += file.size();
+        std::cout << name << ": " << file.size() << " bytes"
+                  << (entry.compression == ARCHIVE_LZ4 ? ", lz4 " + std::to_string(payload.size()) : ", stored") << std::endl;
+    }
+
+    pad(out, offset, 8);
+    header.indexOffset = offset;
+    out.write((const char *)entries.data(), (std::streamsize)(entries.size() * sizeof(ArchiveEntry)));
+    offset += entries.size() * sizeof(ArchiveEntry);
+    header.namesOffset = offset;
+    out.write(names.data(), (std::streamsize)names.size());
+    offset += names.size();
+
+    std::memcpy(header.magic, ASSET_ARCHIVE_MAGIC, 4);
+    header.version = ASSET_ARCHIVE_VERSION;
+    header.entryCount = (uint32_t)entries.size();
+    out.seekp(0);
+    out.write((const char *)&header, sizeof(header));
+    out.close();
+    if (!out || std::rename(tempPath.c_str(), arguments[0].c_str()) != 0)
+    {
+        std::cout << "ERROR::ASSET_PACKER:: could not write " << arguments[0] << std::endl;
+        std::remove(tempPath.c_str());
+        return 1;
+    }
+    double megabyte = 1024.0 * 1024.0;
+    std::cout << arguments[0] << ": " << entries.size() << " entries, " << sourceBytes / megabyte << " MB -> "
+              << offset / megabyte << " MB" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+// Bakes block compressed textures ahead of time, so the first run of the game doesn't have to encode them.
+// Needs no GPU or GL context. Run it from the project root:
+//   ./texture_compressor resources/objects/ship/*.jpg resources/objects/cart/*.jpg
+#include <stb_image.h>
+
+#include <learnopengl/texture_compression.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " <image>..." << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::ifstream in(argv[i], std::ios::binary);
+        std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (file.empty())
+        {
+            std::cout << "ERROR::TEXTURE_COMPRESSOR:: could not read " << argv[i] << std::endl;
+            failures++;
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        int width, height, components;
+        unsigned char *pixels = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &components, 0);
+        double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!pixels || components < 3)
+        {
+            std::cout << argv[i] << ": skipped, only 3 and 4 component images are compressed" << std::endl;
+            stbi_image_free(pixels);
+            continue;
+        }
+
+        CompressedTexture texture;
+        texture.Encode(pixels, width, height, components, decodeMs);
+        stbi_image_free(pixels);
+        std::string bakedPath = CompressedTexturePath(Fnv1a64(file.data(), file.size()));
+        if (!texture.Save(bakedPath))
+        {
+            std::cout << "ERROR::TEXTURE_COMPRESSOR:: could not write " << bakedPath << std::endl;
+            failures++;
+            continue;
+        }
+        double megabyte = 1024.0 * 1024.0;
+        std::cout << argv[i] << " -> " << bakedPath << ": " << texture.FormatName() << " " << width << "x" << height
+                  << ", " << texture.levels.size() << " mips, " << texture.UncompressedBytes() / megabyte << " MB -> "
+                  << texture.CompressedBytes() / megabyte << " MB" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}